@@ -0,0 +1,551 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrentsplaymap.h"
+#include "splaytree.h"
+
+using namespace std;
+
+//результаты поиска накапливаются здесь, чтобы компилятор не выбросил измеряемые вызовы
+volatile size_t sink = 0;
+
+//учет динамической памяти: глобальные operator new/delete хранят размер блока перед ним
+//и ведут текущий и пиковый объем занятой памяти (выделения с выравниванием больше
+//стандартного, например сегменты потокобезопасных отображений, не учитываются)
+atomic<size_t> allocated_bytes(0);
+atomic<size_t> peak_bytes(0);
+//заголовок блока сохраняет стандартное выравнивание
+const size_t allocation_header = alignof(max_align_t);
+
+void *operator new(size_t size)
+{
+    void *p_block = malloc(size + allocation_header);
+    if (!p_block)
+    {
+        throw bad_alloc();
+    }
+    *static_cast<size_t*>(p_block) = size;
+    size_t current = allocated_bytes.fetch_add(size, memory_order_relaxed) + size;
+    size_t peak = peak_bytes.load(memory_order_relaxed);
+    while (current > peak && !peak_bytes.compare_exchange_weak(peak, current, memory_order_relaxed))
+    {
+    }
+    return static_cast<char*>(p_block) + allocation_header;
+}
+
+void operator delete(void *p_memory) noexcept
+{
+    if (!p_memory)
+    {
+        return;
+    }
+    void *p_block = static_cast<char*>(p_memory) - allocation_header;
+    allocated_bytes.fetch_sub(*static_cast<size_t*>(p_block), memory_order_relaxed);
+    free(p_block);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *p_memory) noexcept
+{
+    operator delete(p_memory);
+}
+
+void operator delete(void *p_memory, size_t) noexcept
+{
+    operator delete(p_memory);
+}
+
+void operator delete[](void *p_memory, size_t) noexcept
+{
+    operator delete(p_memory);
+}
+
+//адаптеры операций, общие для деревьев проекта и std::map
+template <typename TTree>
+void tree_insert(TTree &tree, int key)
+{
+    tree.insert(key, key);
+}
+
+void tree_insert(map<int, int> &tree, int key)
+{
+    tree.emplace(key, key);
+}
+
+template <typename TTree>
+bool tree_find(TTree &tree, int key)
+{
+    return tree.contains(key);
+}
+
+bool tree_find(map<int, int> &tree, int key)
+{
+    return tree.find(key) != tree.end();
+}
+
+template <typename TTree>
+void tree_remove(TTree &tree, int key)
+{
+    tree.remove(key);
+}
+
+void tree_remove(map<int, int> &tree, int key)
+{
+    tree.erase(key);
+}
+
+struct workload
+//последовательность запросов поиска с заданным распределением
+{
+    string name;
+    vector<int> queries;
+};
+
+struct benchmark_input
+//входные данные одного прогона: все структуры получают одни и те же последовательности
+{
+    //различные ключи 0..n-1 в случайном порядке (порядок вставки)
+    vector<int> keys;
+    //рабочие нагрузки поиска
+    vector<workload> workloads;
+    //вставка и удаление вперемешку: на шаге i удаляется ключ live[churn_slots[i]]
+    //и на его место вставляется новый ключ churn_keys[i] (ключи n..2n-1 в случайном порядке)
+    vector<size_t> churn_slots;
+    vector<int> churn_keys;
+};
+
+//латентность измеряется у каждой latency_stride-й операции: измерение каждой операции
+//заметно исказило бы пропускную способность (чтение часов сравнимо по времени с поиском)
+const size_t latency_stride = 16;
+
+double percentile(const vector<double> &sorted_latencies, double fraction)
+//перцентиль уже отсортированной выборки (0 для пустой выборки)
+{
+    if (sorted_latencies.empty())
+    {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * sorted_latencies.size());
+    return sorted_latencies[min(index, sorted_latencies.size() - 1)];
+}
+
+void report(const string &structure, const string &workload_name, const string &operation, size_t size,
+            size_t count, double seconds, vector<double> latencies, size_t memory)
+//одна строка CSV на каждую измеренную операцию (латентности в наносекундах, память в байтах)
+{
+    sort(latencies.begin(), latencies.end());
+    cout << structure << ',' << workload_name << ',' << operation << ',' << size << ',' << count << ','
+         << seconds << ',' << ((seconds > 0) ? static_cast<size_t>(count / seconds) : 0) << ','
+         << percentile(latencies, 0.5) << ',' << percentile(latencies, 0.9) << ','
+         << percentile(latencies, 0.99) << ',' << percentile(latencies, 0.999) << ','
+         << (latencies.empty() ? 0 : latencies.back()) << ',' << memory << endl;
+}
+
+template <typename TOperation>
+void measure(const string &structure, const string &workload_name, const string &operation, size_t size,
+             size_t count, size_t base_memory, TOperation &&operation_at)
+//выполнение count операций operation_at(i) с замером общего времени и выборочной латентности;
+//память - пиковый объем, занятый сверх base_memory за время измерения
+{
+    //память под выборку латентностей выделяется до начала измерения и вычитается из пика
+    vector<double> latencies;
+    latencies.reserve(count / latency_stride + 1);
+    peak_bytes.store(allocated_bytes.load());
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i % latency_stride)
+        {
+            operation_at(i);
+        }
+        else
+        {
+            chrono::steady_clock::time_point operation_start = chrono::steady_clock::now();
+            operation_at(i);
+            chrono::duration<double, nano> latency = chrono::steady_clock::now() - operation_start;
+            latencies.push_back(latency.count());
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    size_t peak = peak_bytes.load() - latencies.capacity() * sizeof(double);
+    size_t memory = (peak > base_memory) ? peak - base_memory : 0;
+    report(structure, workload_name, operation, size, count, elapsed.count(), latencies, memory);
+}
+
+template <typename TTree>
+void run(const string &structure, const benchmark_input &input)
+//вставка всех ключей, поиск во всех нагрузках, вставка и удаление вперемешку и удаление всех ключей
+//нагрузки выполняются на одном дереве по очереди, поэтому splay-дерево начинает каждую
+//нагрузку с формой, оставшейся от предыдущей
+{
+    const vector<int> &keys = input.keys;
+    size_t size = keys.size();
+    //ключи, находящиеся в дереве, в порядке слотов (для вставки и удаления вперемешку)
+    vector<int> live = keys;
+    size_t base_memory = allocated_bytes.load();
+    TTree tree;
+    measure(structure, "random", "insert", size, size, base_memory, [&tree, &keys](size_t i)
+    {
+        tree_insert(tree, keys[i]);
+    });
+
+    for (size_t w = 0; w < input.workloads.size(); w++)
+    {
+        const vector<int> &queries = input.workloads[w].queries;
+        size_t found = 0;
+        measure(structure, input.workloads[w].name, "find", size, queries.size(), base_memory,
+                [&tree, &queries, &found](size_t i)
+        {
+            found += tree_find(tree, queries[i]);
+        });
+        sink = sink + found;
+    }
+
+    const vector<size_t> &slots = input.churn_slots;
+    const vector<int> &churn_keys = input.churn_keys;
+    measure(structure, "churn", "insert_remove", size, 2 * slots.size(), base_memory,
+            [&tree, &live, &slots, &churn_keys](size_t i)
+    {
+        size_t step = i / 2;
+        if (i % 2 == 0)
+        {
+            tree_remove(tree, live[slots[step]]);
+        }
+        else
+        {
+            live[slots[step]] = churn_keys[step];
+            tree_insert(tree, churn_keys[step]);
+        }
+    });
+
+    measure(structure, "random", "remove", size, live.size(), base_memory, [&tree, &live](size_t i)
+    {
+        tree_remove(tree, live[i]);
+    });
+}
+
+void run_frozen(const benchmark_input &input)
+//построение неизменяемого снимка splay-дерева и поиск в нем
+{
+    const vector<int> &keys = input.keys;
+    size_t size = keys.size();
+    splay_tree<int, int> tree;
+    for (size_t i = 0; i < size; i++)
+    {
+        tree.insert(keys[i], keys[i]);
+    }
+    //учитывается только память снимка
+    size_t base_memory = allocated_bytes.load();
+    frozen_tree<int, int> frozen;
+    //снимок строится одной операцией, поэтому ее латентность совпадает с общим временем
+    measure("frozen_tree", "random", "freeze", size, 1, base_memory, [&tree, &frozen](size_t)
+    {
+        frozen = tree.freeze();
+    });
+
+    for (size_t w = 0; w < input.workloads.size(); w++)
+    {
+        const vector<int> &queries = input.workloads[w].queries;
+        size_t found = 0;
+        measure("frozen_tree", input.workloads[w].name, "find", size, queries.size(), base_memory,
+                [&frozen, &queries, &found](size_t i)
+        {
+            found += frozen.contains(queries[i]);
+        });
+        sink = sink + found;
+    }
+}
+
+template <typename TMap>
+void run_concurrent(const string &structure, const benchmark_input &input)
+//масштабирование поиска в потокобезопасном отображении: потоков от одного до числа аппаратных потоков,
+//каждый поток выполняет все запросы первой нагрузки, начиная со своего смещения
+//(латентность отдельных операций здесь не измеряется)
+{
+    const vector<int> &keys = input.keys;
+    const vector<int> &queries = input.workloads.front().queries;
+    TMap map;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        map.insert(keys[i], keys[i]);
+    }
+    size_t max_threads = max<size_t>(thread::hardware_concurrency(), 1);
+    for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        vector<thread> threads;
+        vector<size_t> found(thread_count, 0);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t t = 0; t < thread_count; t++)
+        {
+            threads.emplace_back([&map, &queries, &found, t, thread_count]()
+            {
+                size_t offset = t * queries.size() / thread_count;
+                for (size_t i = 0; i < queries.size(); i++)
+                {
+                    found[t] += map.contains(queries[(offset + i) % queries.size()]);
+                }
+            });
+        }
+        for (size_t t = 0; t < thread_count; t++)
+        {
+            threads[t].join();
+            sink = sink + found[t];
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        report(structure, input.workloads.front().name, "find_x" + to_string(thread_count), keys.size(),
+               queries.size() * thread_count, elapsed.count(), vector<double>(), 0);
+    }
+}
+
+benchmark_input make_input(size_t size, unsigned seed)
+//генерация ключей и нагрузок; при одинаковых размере и зерне последовательности совпадают
+{
+    benchmark_input input;
+    mt19937 generator(seed);
+    input.keys.resize(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        input.keys[i] = static_cast<int>(i);
+    }
+    shuffle(input.keys.begin(), input.keys.end(), generator);
+    if (!size)
+    {
+        input.workloads.push_back(workload{"uniform", vector<int>()});
+        return input;
+    }
+    size_t query_count = size;
+    uniform_int_distribution<int> key_distribution(0, static_cast<int>(size) - 1);
+
+    //равномерно распределенные запросы
+    workload uniform{"uniform", vector<int>(query_count)};
+    for (size_t i = 0; i < query_count; i++)
+    {
+        uniform.queries[i] = key_distribution(generator);
+    }
+    input.workloads.push_back(uniform);
+
+    //распределение Ципфа с показателем 0.99: ключ ранга r запрашивается с вероятностью,
+    //пропорциональной 1 / r^0.99; популярные ключи разбросаны по всему диапазону
+    workload zipf{"zipf", vector<int>(query_count)};
+    vector<double> cumulative(size);
+    double total = 0;
+    for (size_t r = 0; r < size; r++)
+    {
+        total += 1.0 / pow(static_cast<double>(r + 1), 0.99);
+        cumulative[r] = total;
+    }
+    uniform_real_distribution<double> real_distribution(0, total);
+    for (size_t i = 0; i < query_count; i++)
+    {
+        size_t rank = lower_bound(cumulative.begin(), cumulative.end(), real_distribution(generator)) - cumulative.begin();
+        zipf.queries[i] = input.keys[min(rank, size - 1)];
+    }
+    input.workloads.push_back(zipf);
+
+    //последовательный обход всех ключей по возрастанию
+    workload sequential{"sequential", vector<int>(query_count)};
+    for (size_t i = 0; i < query_count; i++)
+    {
+        sequential.queries[i] = static_cast<int>(i % size);
+    }
+    input.workloads.push_back(sequential);
+
+    //временная локальность: 10 фаз, в каждой фазе запросы равномерно распределены
+    //по рабочему множеству из 1% ключей, которое меняется от фазы к фазе
+    workload working_set{"working_set", vector<int>(query_count)};
+    size_t set_size = max<size_t>(size / 100, 1);
+    size_t phase_length = max<size_t>(query_count / 10, 1);
+    uniform_int_distribution<size_t> offset_distribution(0, size - set_size);
+    uniform_int_distribution<size_t> member_distribution(0, set_size - 1);
+    size_t set_offset = 0;
+    for (size_t i = 0; i < query_count; i++)
+    {
+        if (i % phase_length == 0)
+        {
+            set_offset = offset_distribution(generator);
+        }
+        working_set.queries[i] = input.keys[set_offset + member_distribution(generator)];
+    }
+    input.workloads.push_back(working_set);
+
+    //вставка и удаление вперемешку: новые ключи в случайном порядке, чтобы несбалансированное
+    //дерево не вырождалось в список
+    input.churn_keys.resize(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        input.churn_keys[i] = static_cast<int>(size + i);
+    }
+    shuffle(input.churn_keys.begin(), input.churn_keys.end(), generator);
+    input.churn_slots.resize(size);
+    uniform_int_distribution<size_t> slot_distribution(0, size - 1);
+    for (size_t i = 0; i < size; i++)
+    {
+        input.churn_slots[i] = slot_distribution(generator);
+    }
+    return input;
+}
+
+//имена структур, которые можно выбрать фильтром
+const char *const structure_names[] = {
+    "splay_tree",
+    "splay_tree<semi_splay>",
+    "splay_tree<depth_splay>",
+    "splay_tree<periodic_splay>",
+    "splay_tree<random_splay>",
+    "binary_tree",
+    "std::map",
+    "frozen_tree",
+    "concurrent_splay_map",
+    "combining_splay_map"
+};
+
+bool parse_number(const string &argument, unsigned long max_value, unsigned long &value)
+//десятичное число без знака не больше max_value
+{
+    if (argument.empty() || argument.find_first_not_of("0123456789") != string::npos)
+    {
+        return false;
+    }
+    errno = 0;
+    value = strtoul(argument.c_str(), nullptr, 10);
+    return errno == 0 && value <= max_value;
+}
+
+bool parse_sizes(const string &argument, vector<size_t> &sizes)
+//список размеров через запятую; ключи нагрузки вставки и удаления доходят до 2n - 1,
+//поэтому размер ограничен половиной диапазона int
+{
+    stringstream stream(argument);
+    string item;
+    while (getline(stream, item, ','))
+    {
+        unsigned long size = 0;
+        if (!parse_number(item, INT_MAX / 2, size))
+        {
+            return false;
+        }
+        sizes.push_back(size);
+    }
+    return !sizes.empty();
+}
+
+bool selected(const string &filter, const string &structure)
+//структура выбрана фильтром: "all" или подстрока имени структуры
+{
+    return filter == "all" || structure.find(filter) != string::npos;
+}
+
+bool known_filter(const string &filter)
+//фильтр выбирает хотя бы одну структуру
+{
+    for (size_t i = 0; i < sizeof(structure_names) / sizeof(structure_names[0]); i++)
+    {
+        if (selected(filter, structure_names[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_usage(ostream &stream, const char *program)
+{
+    stream << "usage: " << program << " [sizes [seed [structure]]]" << endl
+           << "  sizes      comma-separated element counts (default 1000000)" << endl
+           << "  seed       random generator seed (default 1)" << endl
+           << "  structure  all (default) or a substring of one of:";
+    for (size_t i = 0; i < sizeof(structure_names) / sizeof(structure_names[0]); i++)
+    {
+        stream << ' ' << structure_names[i];
+    }
+    stream << endl;
+}
+
+int main(int argc, char *argv[])
+//параметры: размеры через запятую (по умолчанию 1000000), зерно генератора (по умолчанию 1)
+//и фильтр структур (подстрока имени, по умолчанию all)
+//результаты выводятся в формате CSV: латентности - перцентили выборки в наносекундах,
+//peak_bytes - пиковый объем динамической памяти структуры во время операции
+{
+    if (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))
+    {
+        print_usage(cout, argv[0]);
+        return 0;
+    }
+    vector<size_t> sizes;
+    unsigned long seed = 1;
+    string filter = (argc > 3) ? argv[3] : "all";
+    if (argc > 4 || !parse_sizes((argc > 1) ? argv[1] : "1000000", sizes) ||
+        (argc > 2 && !parse_number(argv[2], UINT_MAX, seed)) || !known_filter(filter))
+    //неизвестный аргумент: выводим подсказку вместо пустой таблицы
+    {
+        print_usage(cerr, argv[0]);
+        return 1;
+    }
+
+    cout << "structure,workload,operation,size,count,seconds,ops_per_sec,"
+            "p50_ns,p90_ns,p99_ns,p999_ns,max_ns,peak_bytes" << endl;
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        benchmark_input input = make_input(sizes[s], static_cast<unsigned>(seed));
+        if (selected(filter, "splay_tree"))
+        {
+            run<splay_tree<int, int>>("splay_tree", input);
+        }
+        //политики splay при поиске
+        if (selected(filter, "splay_tree<semi_splay>"))
+        {
+            run<splay_tree<int, int, compact_layout, node_allocator, comparator<int>, semi_splay>>("splay_tree<semi_splay>", input);
+        }
+        if (selected(filter, "splay_tree<depth_splay>"))
+        {
+            run<splay_tree<int, int, compact_layout, node_allocator, comparator<int>, depth_splay<>>>("splay_tree<depth_splay>", input);
+        }
+        if (selected(filter, "splay_tree<periodic_splay>"))
+        {
+            run<splay_tree<int, int, compact_layout, node_allocator, comparator<int>, periodic_splay<>>>("splay_tree<periodic_splay>", input);
+        }
+        if (selected(filter, "splay_tree<random_splay>"))
+        {
+            run<splay_tree<int, int, compact_layout, node_allocator, comparator<int>, random_splay<>>>("splay_tree<random_splay>", input);
+        }
+        if (selected(filter, "binary_tree"))
+        {
+            run<binary_tree<int, int>>("binary_tree", input);
+        }
+        if (selected(filter, "std::map"))
+        {
+            run<map<int, int>>("std::map", input);
+        }
+        if (selected(filter, "frozen_tree"))
+        {
+            run_frozen(input);
+        }
+        if (selected(filter, "concurrent_splay_map"))
+        {
+            run_concurrent<concurrent_splay_map<int, int>>("concurrent_splay_map", input);
+        }
+        if (selected(filter, "combining_splay_map"))
+        {
+            run_concurrent<combining_splay_map<int, int>>("combining_splay_map", input);
+        }
+    }
+    return 0;
+}
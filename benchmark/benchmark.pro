@@ -0,0 +1,20 @@
+TEMPLATE = app
+CONFIG += console c++17 release
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        benchmark.cpp
+
+HEADERS += \
+    ../binarytree.h \
+    ../comparator.h \
+    ../concurrentsplaymap.h \
+    ../frozentree.h \
+    ../nodeallocator.h \
+    ../node.h \
+    ../splaytree.h \
+    ../treeexception.h \
+    ../treeiterator.h
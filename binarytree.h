@@ -4,10 +4,16 @@
 #include <iostream>
 #include <functional>
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <utility>
+#include <type_traits>
 #include "comparator.h"
+#include "frozentree.h"
 #include "node.h"
+#include "nodeallocator.h"
+#include "treeiterator.h"
 #include "treeexception.h"
 
 enum status_t {
@@ -20,14 +26,14 @@ enum status_t {
 };
 
 namespace bst {
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *find_remove_node(node<TKey, TValue> *root_node, TKey key, comparator<TKey> *key_comparator)
+    template <typename TNode, typename TKey, typename TComparator>
+    TNode *find_remove_node(TNode *root_node, const TKey &key, const TComparator &key_comparator)
     {
-        node <TKey, TValue> *current_node = root_node;
+        TNode *current_node = root_node;
         while(current_node)//выделить все алгоритмы в отдельный класс
         //ищем удаляемый элемент
         {
-            compare_t compare_result = (*key_comparator)(key, current_node->key);
+            compare_t compare_result = key_comparator(key, current_node->key);
             if (compare_result == LESS)
             //идем по левой стороне
             {
@@ -46,223 +52,505 @@ namespace bst {
     }
     return current_node;
 }
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *get_left(node<TKey, TValue> *p_node)
-    //получить указатель на левого потомка
+    template <typename TNode>
+    TNode *find_min_node(TNode* root_node)
+    //найти минимальный элемент в дереве
     {
-        if (p_node)
+        if(!root_node)
+        //дерево пустое
+        {
+            return nullptr;
+        }
+        //идем по левому поддереву до конца (там где наименьший элемент)
+        while (root_node->left)
         {
-            return p_node->left;
+            root_node = root_node->left;
         }
-        return nullptr;
+        return root_node;
     }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *get_right(node<TKey, TValue> *p_node)
-    //получить указатель на правого потомка
+    template <typename TNode>
+    void compress(TNode *&root_node, size_t count)
+    //один проход алгоритма Day-Stout-Warren: count левых поворотов вдоль правого пути дерева,
+    //начиная с корня, через узел
     {
-        if (p_node)
+        TNode *scanner_node = nullptr;
+        for (size_t i = 0; i < count; i++)
         {
-            return p_node->right;
+            TNode *child_node = scanner_node ? static_cast<TNode*>(scanner_node->right) : root_node;
+            TNode *next_node = child_node->right;
+            child_node->right = next_node->left;
+            next_node->left = child_node;
+            node_traits<TNode>::update(child_node);
+            node_traits<TNode>::update(next_node);
+            if (scanner_node)
+            {
+                scanner_node->right = next_node;
+            }
+            else
+            {
+                root_node = next_node;
+            }
+            scanner_node = next_node;
         }
-        return nullptr;
     }
 
+    template <typename TNode>
+    size_t tree_to_vine(TNode *&root_node)
+    //превращение дерева в "лозу" (упорядоченный список узлов, связанных правыми ссылками)
+    //правыми поворотами за O(n) без дополнительной памяти, возвращает количество узлов
+    {
+        size_t count = 0;
+        TNode *tail_node = nullptr;
+        TNode *current_node = root_node;
+        while (current_node)
+        {
+            if (current_node->left)
+            //поворачиваем направо, поднимая левого потомка
+            {
+                TNode *left_node = current_node->left;
+                current_node->left = left_node->right;
+                left_node->right = current_node;
+                current_node = left_node;
+                if (tail_node)
+                {
+                    tail_node->right = current_node;
+                }
+                else
+                {
+                    root_node = current_node;
+                }
+            }
+            else
+            //левого потомка нет, узел занимает свое место в лозе
+            {
+                tail_node = current_node;
+                current_node = current_node->right;
+                count++;
+            }
+        }
+        return count;
+    }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *find_min_node(node<TKey, TValue>* root_node)
-    //найти минимальный элемент в дереве
+    template <typename TNode>
+    void vine_to_tree(TNode *&root_node, size_t count)
+    //превращение "лозы" (упорядоченного списка из count узлов, связанных правыми ссылками)
+    //в идеально сбалансированное дерево за O(n) без сравнений и без дополнительной памяти
     {
-        if(!root_node)
-        //дерево пустое
+        if constexpr (node_traits<TNode>::has_size)
+        //размеры поддеревьев лозы: каждый узел содержит себя и все узлы ниже по лозе
         {
-            return nullptr;
+            size_t vine_size = count;
+            for (TNode *current_node = root_node; current_node; current_node = current_node->right)
+            {
+                current_node->size = vine_size--;
+            }
         }
-        else if(!root_node->left)
-        //дошли до конца левого поддерева (там где наименьший элемент)
+        //количество узлов в наибольшем полном дереве, которое помещается в count узлов
+        size_t full_count = 1;
+        while (full_count <= count + 1)
         {
-            return root_node;
+            full_count <<= 1;
         }
-        else
-        //рекурсивно идем по левому поддереву
+        full_count = (full_count >> 1) - 1;
+        //узлы, не поместившиеся в полное дерево, уходят на нижний уровень
+        compress(root_node, count - full_count);
+        while (full_count > 1)
         {
-            return find_min_node(root_node->left);
+            full_count >>= 1;
+            compress(root_node, full_count);
         }
     }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *get_parent(node<TKey, TValue> *root_node,
-                                   node<TKey, TValue> *p_node,
-                                   comparator<TKey> *key_comparator)
-    //получить указатель на предка узла p_node
+    template <typename TNode, typename TKey, typename TComparator>
+    void add_path_size(TNode *root_node, const TKey &key, const TComparator &key_comparator, ptrdiff_t delta)
+    //изменение на delta размеров поддеревьев всех предков элемента с ключом key
+    //(только для узлов с размером поддерева, для остальных узлов ничего не делает)
     {
-        node<TKey, TValue> *parent_node = nullptr;
-        if (!root_node)
-        //дерево пустое
+        if constexpr (node_traits<TNode>::has_size)
         {
-            return nullptr;
+            TNode *current_node = root_node;
+            while (current_node)
+            {
+                compare_t compare_result = key_comparator(key, current_node->key);
+                if (compare_result == EQUAL)
+                {
+                    break;
+                }
+                current_node->size += delta;
+                current_node = (compare_result == LESS) ? current_node->left : current_node->right;
+            }
         }
-        if (!p_node)
-        //элемент, для которого ищется предок, пустой
+    }
+
+    template <typename TVisitor, typename TKey, typename TValue>
+    bool visit(TVisitor &visitor, const TKey &key, const TValue &value, int depth)
+    //вызов посетителя обхода: если он возвращает значение, то false означает остановку обхода
+    {
+        if constexpr (std::is_void<decltype(visitor(key, value, depth))>::value)
         {
-            return nullptr;
+            visitor(key, value, depth);
+            return true;
         }
-        while (root_node && root_node->key != p_node->key)
+        else
         {
-            compare_t compare_result = (*key_comparator)(p_node->key, root_node->key);
-            parent_node = root_node;
-            if (compare_result == LESS)
-            //идем по левой стороне
-            {
-                root_node = root_node->left;
-            }
-            else if (compare_result == GREAT)
-            //идем по правой стороне
-            {
-                root_node = root_node->right;
-            }
+            return static_cast<bool>(visitor(key, value, depth));
+        }
+    }
+
+    template <typename TVisitor, typename TKey, typename TValue>
+    bool visit(TVisitor &visitor, const TKey &key, const TValue &value)
+    //то же для посетителя без глубины
+    {
+        if constexpr (std::is_void<decltype(visitor(key, value))>::value)
+        {
+            visitor(key, value);
+            return true;
+        }
+        else
+        {
+            return static_cast<bool>(visitor(key, value));
         }
-        return parent_node;
     }
 }
 
-template <typename TKey, typename TValue>
+struct bst_methods
+//статическая политика шагов шаблонных методов поиска, вставки и удаления обычного бинарного дерева поиска
+//политика производного дерева наследуется от нее и скрывает нужные методы одноименными,
+//шаблонные методы дерева вызывают шаги политики напрямую, без виртуальных вызовов
+{
+    //меняет ли хук поиска форму дерева (после него пути итераторов строятся заново)
+    static const bool find_restructures = false;
+    //основной метод поиска элемента в дереве
+    //в find_node возвращает указатель на найденный элемент
+    //node_count - количество элементов дерева (нужно политикам, зависящим от высоты дерева)
+    template <typename TNode, typename TKey, typename TComparator>
+    static status_t inner_find(TNode *&root_node,
+                               const TKey &key,
+                               const TComparator &key_comparator,
+                               TNode *&find_node,
+                               size_t node_count);
+    //метод-хук, вызываемый после основного метода поиска элемента в дереве
+    template <typename TNode, typename TComparator>
+    static void post_find_hook(TNode *&root_node,
+                               TNode *&find_node,
+                               const TComparator &key_comparator,
+                               size_t node_count);
+    //основной метод вставки элемента в дерево
+    //в insert_node возвращает указатель на вставленный элемент
+    template <typename TNode, typename TComparator>
+    static status_t inner_insert(TNode *&root_node,
+                                 const TComparator &key_comparator,
+                                 TNode *&insert_node);
+    //метод-хук, вызываемый после основного метода вставки элемента в дерево
+    template <typename TNode, typename TComparator>
+    static void post_insert_hook(TNode *&root_node,
+                                 TNode *&insert_node,
+                                 const TComparator &key_comparator);
+    //основной метод удаления элемента из дерева
+    template <typename TNode, typename TKey, typename TComparator, typename TNodeAllocator>
+    static status_t inner_remove(TNode *&root_node,
+                                 const TKey &key,
+                                 const TComparator &key_comparator,
+                                 TNodeAllocator &allocator);
+    //метод-хук, вызываемый после основного метода удаления элемента из дерева
+    template <typename TNode, typename TComparator>
+    static void post_remove_hook(TNode *&root_node,
+                                 const TComparator &key_comparator);
+};
+
+template <typename TKey, typename TValue, typename TLayout = full_layout, template <typename> class TAllocator = node_allocator,
+          typename TComparator = comparator<TKey>, typename TMethods = bst_methods>
 class binary_tree
+//поведение операций задается статической политикой TMethods (см. bst_methods)
 {
+    //деревья с другой политикой операций (например, splay-дерево) копируются поузлово
+    template <typename, typename, typename, template <typename> class, typename, typename>
+    friend class binary_tree;
 protected:
+    //тип узла дерева определяется политикой структуры узла TLayout
+    typedef typename TLayout::template node_type<TKey, TValue> node_type;
     //вложенный класс исключения "ошибка поиска"
     class find_error_exception : public tree_exception
     {
     public:
-        find_error_exception(TKey key);
+        template <typename TOtherKey>
+        find_error_exception(const TOtherKey &key);
     };
     //вложенный класс исключения "ошибка вставки"
     class insert_error_exception : public tree_exception
     {
     public:
-        insert_error_exception(TKey key);
+        insert_error_exception(const TKey &key);
     };
     //вложенный класс исключения "ошибка удаления"
     class remove_error_exception : public tree_exception
     {
     public:
-        remove_error_exception(TKey key);
+        remove_error_exception(const TKey &key);
+    };
+    //вложенный класс исключения "ошибка порядка" (нарушена упорядоченность входной последовательности)
+    class order_error_exception : public tree_exception
+    {
+    public:
+        order_error_exception(const TKey &key);
     };
+    //распределитель узлов дерева
+    typedef TAllocator<node_type> allocator_type;
+    //узлы index_layout ссылаются друг на друга индексами в node_arena,
+    //поэтому выделять их другим распределителем нельзя
+    static_assert(!std::is_same<node_type, index_node<TKey, TValue>>::value ||
+                  std::is_same<allocator_type, node_arena<node_type>>::value,
+                  "index_layout requires the node_arena allocator");
+
     class find_template_method
     //вложенный класс шаблонного метода поиска элемента в дереве
+    //основной метод и хук берутся из политики TMethods
     {
     public:
         //декорирующий интерфейсный метод (обертка) для поиска элемента в дереве
-        //не может быть переопределен в наследуемом классе
-        node<TKey, TValue> *invoke_find(node<TKey, TValue> *&root_node,
-                                        TKey key,
-                                        comparator<TKey> *key_comparator);
-    protected:
-        //основной метод поиска элемента в дереве
-        //в find_node возвращает указатель на найденный элемент
-        //в случае необходимости может быть переопределен в наследуемом классе
-        virtual status_t inner_find(node<TKey, TValue> *&root_node,
-                                    TKey key,
-                                    comparator<TKey> *key_comparator,
-                                    node<TKey, TValue> *&find_node);
-        //метод-хук, вызываемый после основного метода поиска элемента в дереве
-        //в случае необходимости может быть переопределен в наследуемом классе
-        virtual void post_find_hook(node<TKey, TValue> *&root_node,
-                                    node<TKey, TValue> *&find_node,
-                                    comparator<TKey> *key_comparator);
+        static node_type *invoke_find(node_type *&root_node,
+                                      const TKey &key,
+                                      const TComparator &key_comparator,
+                                      size_t node_count);
+        //то же, но при отсутствии элемента вместо исключения возвращает nullptr
+        static node_type *try_invoke_find(node_type *&root_node,
+                                          const TKey &key,
+                                          const TComparator &key_comparator,
+                                          size_t node_count);
+        //поиск по ключу другого типа: обычный спуск по дереву, после которого хук
+        //вызывается для найденного элемента, а при его отсутствии - для последнего посещенного
+        template <typename TOtherKey>
+        static node_type *try_invoke_find(node_type *&root_node,
+                                          const TOtherKey &key,
+                                          const TComparator &key_comparator,
+                                          size_t node_count);
     };
 
     class insert_template_method
     //вложенный класс шаблонного метода вставки элемента в дерево
+    //основной метод и хук берутся из политики TMethods
     {
     public:
         //декорирующий интерфейсный метод (обертка) для вставки элемента в дерево
-        //не может быть переопределен в наследуемом классе
-        void invoke_insert(node<TKey, TValue> *&root_node, TKey key,
-                           TValue value,
-                           comparator<TKey> *key_comparator);
-    protected:
-        //основной метод вставки элемента в дерево
-        //в insert_node возвращает указатель на вставленный элемент
-        //в случае необходимости может быть переопределен в наследуемом классе
-        virtual status_t inner_insert(node<TKey, TValue> *&root_node,
-                                      TKey key,
-                                      TValue value,
-                                      comparator<TKey> *key_comparator,
-                                      node<TKey, TValue> *&insert_node);
-        //метод-хук, вызываемый после основного метода вставки элемента в дерево
-        //в случае необходимости может быть переопределен в наследуемом классе
-        virtual void post_insert_hook(node<TKey, TValue> *&root_node,
-                                      node<TKey, TValue> *&insert_node,
-                                      comparator<TKey> *key_comparator);
+        //вставляемый узел insert_node уже создан распределителем allocator,
+        //при неудачной вставке он уничтожается
+        static void invoke_insert(node_type *&root_node,
+                                  node_type *insert_node,
+                                  const TComparator &key_comparator,
+                                  allocator_type &allocator);
+        //то же, но вместо исключения возвращает статус вставки
+        static status_t try_invoke_insert(node_type *&root_node,
+                                          node_type *insert_node,
+                                          const TComparator &key_comparator,
+                                          allocator_type &allocator);
     };
 
     class remove_template_method
     //вложенный класс шаблонного метода удаления элемента из дерева
+    //основной метод и хук берутся из политики TMethods
     {
     public:
         //декорирующий интерфейсный метод (обертка) для удаления элемента из дерева
-        //не может быть переопределен в наследуемом классе
-        void invoke_remove(node<TKey, TValue> *&root_node,
-                           TKey key,
-                           comparator<TKey> *key_comparator);
-    protected:
-        //основной метод удаления элемента из дерева
-        //в случае необходимости может быть переопределен в наследуемом классе
-        virtual status_t inner_remove(node<TKey, TValue> *&root_node,
-                                      TKey key,
-                                      comparator<TKey> *key_comparator);
-        //метод-хук, вызываемый после основного метода удаления элемента из дерева
-        //в случае необходимости может быть переопределен в наследуемом классе
-        virtual void post_remove_hook(node<TKey, TValue> *&root_node,
-                                 comparator<TKey> *key_comparator);
+        static void invoke_remove(node_type *&root_node,
+                                  const TKey &key,
+                                  const TComparator &key_comparator,
+                                  allocator_type &allocator);
+        //то же, но вместо исключения возвращает статус удаления
+        static status_t try_invoke_remove(node_type *&root_node,
+                                          const TKey &key,
+                                          const TComparator &key_comparator,
+                                          allocator_type &allocator);
     };
 
 public:
     //функция обратного вызова
     typedef std::function<void(TKey key, TValue value, int depth)> callback_function;
+    //итераторы по элементам дерева в порядке возрастания ключей
+    typedef tree_iterator<node_type, false> iterator;
+    typedef tree_iterator<node_type, true> const_iterator;
 
-    binary_tree(comparator<TKey> *key_comparator);
-    binary_tree(binary_tree<TKey, TValue> &tree);
+    binary_tree(const TComparator &key_comparator = TComparator());
+    binary_tree(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods> &tree);
+    //копирование дерева с другой политикой операций (форма дерева сохраняется)
+    template <typename TOtherMethods>
+    binary_tree(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TOtherMethods> &tree);
+    binary_tree(binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods> &&tree);
     virtual ~binary_tree();
     binary_tree& operator = (const binary_tree &tree_object);
+    binary_tree& operator = (binary_tree &&tree_object);
+    //обмен содержимым с другим деревом за O(1)
+    void swap(binary_tree &tree);
 
-    TValue find(TKey key);
+    TValue find(const TKey &key);
+    //поиск без исключений: указатель на значение или nullptr, если элемента нет
+    TValue *try_find(const TKey &key);
+    //проверка наличия элемента в дереве
+    bool contains(const TKey &key);
+    //поиск по ключу другого типа, сравнимого с TKey (например, const char* или std::string_view
+    //для ключей std::string), без построения временного ключа
+    template <typename TOtherKey>
+    TValue find(const TOtherKey &key);
+    template <typename TOtherKey>
+    TValue *try_find(const TOtherKey &key);
+    template <typename TOtherKey>
+    bool contains(const TOtherKey &key);
+    //вставка и поиск с подсказкой: место ключа ищется от позиции hint, а не от корня,
+    //поэтому для ключа рядом с hint (например, при вставке возрастающих ключей) - за амортизированное O(1)
+    //недействительная подсказка (end(), итератор до изменения корня) - обычный спуск от корня
+    //итератор хранит путь от корня: из подсказки-lvalue путь не меняется, а в результат копируется
+    //его общая с результатом часть (O(глубины найденного узла) указателей); путь подсказки,
+    //переданной через std::move, забирается без копирования
+    //вставка возвращает итератор на новый элемент, а при повторе ключа выбрасывает исключение;
+    //поиск возвращает итератор на найденный элемент или end()
+    template <bool other_const>
+    iterator insert(const tree_iterator<node_type, other_const> &hint, TKey key, TValue value);
+    template <bool other_const>
+    iterator insert(tree_iterator<node_type, other_const> &&hint, TKey key, TValue value);
+    template <bool other_const>
+    iterator find(const tree_iterator<node_type, other_const> &hint, const TKey &key);
+    template <bool other_const>
+    iterator find(tree_iterator<node_type, other_const> &&hint, const TKey &key);
+    //константные версии поиска не вызывают хук и не меняют форму дерева
+    //(в splay-дереве найденный элемент не поднимается в корень), поэтому их можно
+    //вызывать из нескольких потоков одновременно, если дерево при этом не изменяется
+    TValue find(const TKey &key) const;
+    const TValue *try_find(const TKey &key) const;
+    bool contains(const TKey &key) const;
     void insert(TKey key, TValue value);
-    void remove(TKey key);
+    //вставка элемента, конструируемого прямо в узле дерева из аргументов
+    //возвращает ссылку на вставленное значение, при повторе ключа выбрасывает исключение
+    template <typename TKeyArg, typename... TValueArgs>
+    TValue &emplace(TKeyArg &&key, TValueArgs&&... value_args);
+    //то же, но без исключения: если ключ уже есть, аргументы не используются,
+    //а возвращается указатель на существующее значение и false
+    template <typename TKeyArg, typename... TValueArgs>
+    std::pair<TValue*, bool> try_emplace(TKeyArg &&key, TValueArgs&&... value_args);
+    void remove(const TKey &key);
+    //то же без исключения: один спуск, false - элемента не было
+    bool try_remove(const TKey &key);
+    //пакетная вставка последовательности пар (ключ, значение) и пакетное удаление последовательности ключей
+    //пакет сортируется и применяется одним проходом слияния с деревом (для больших пакетов)
+    //или последовательными операциями в порядке возрастания ключей (для малых пакетов)
+    //возвращают статус каждого элемента пакета в исходном порядке, исключений не выбрасывают
+    template <typename TIterator>
+    std::vector<status_t> insert_many(TIterator first, TIterator last);
+    template <typename TIterator>
+    std::vector<status_t> remove_many(TIterator first, TIterator last);
+    //пакетный поиск последовательности ключей: ключи сортируются и ищутся по возрастанию,
+    //каждый поиск продолжается от пути к предыдущему ключу (палец), а не от корня
+    //в values для каждого ключа пакета записывается указатель на значение или nullptr,
+    //возвращается статус каждого ключа в исходном порядке, исключений нет
+    //хук поиска вызывается после поиска всего пакета в порядке возрастания ключей для каждого ключа,
+    //как в try_find: для найденного элемента, а при промахе - для последнего посещенного
+    //(splay-дерево при этом получает последовательный доступ)
+    template <typename TIterator>
+    std::vector<status_t> find_many(TIterator first, TIterator last, std::vector<TValue*> &values);
+    //количество элементов в дереве
+    //(если оно стало неизвестным после разделения дерева, пересчитывается за O(n) один раз)
+    size_t size() const;
+    bool empty() const;
+    //удаление всех элементов дерева
+    void clear();
+    //построение сбалансированного дерева из отсортированной последовательности пар (ключ, значение)
+    //без повторяющихся ключей за O(n) без сравнений; прежнее содержимое дерева удаляется
+    template <typename TIterator>
+    void assign_sorted(TIterator first, TIterator last);
+    //то же, но с проверкой строгого возрастания ключей
+    //при нарушении порядка выбрасывается исключение, а дерево остается пустым
+    template <typename TIterator>
+    void assign_sorted_checked(TIterator first, TIterator last);
+    //неизменяемый снимок дерева в виде массива для поиска без блокировок из любого числа потоков
+    //форма дерева не меняется, последующие изменения дерева на снимок не влияют
+    frozen_tree<TKey, TValue, TComparator> freeze() const;
 
-    void prefix_traversal(callback_function function) const;
-    void postfix_traversal(callback_function function) const;
-    void infix_traversal(callback_function function) const;
-protected:
-    //пустой конструктор
-    //вызывается только в конструкторе производного класса
-    binary_tree();
-    //инициализация шаблонных методов
-    void init_template_methods(find_template_method *finder,
-                               insert_template_method *inserter,
-                               remove_template_method *remover);
-    void prefix_traversal_base(node<TKey, TValue> *root_node,
-                               callback_function function,
-                               int depth) const;
-    void postfix_traversal_base(node<TKey, TValue> *root_node,
-                                callback_function function,
-                                int depth) const;
-    void infix_traversal_base(node<TKey, TValue> *roott_node,
-                              callback_function function,
-                              int depth) const;
-    node<TKey, TValue> *root_node = nullptr;
-    comparator<TKey> *key_comparator;
-private:
-    //указатели на классы шаблонных методов
-    find_template_method *finder;
-    insert_template_method *inserter;
-    remove_template_method *remover;
+    //обходы дерева без рекурсии (глубина дерева ограничена только памятью под явный стек)
+    //посетитель вызывается как visitor(key, value, depth) с константными ссылками на ключ и значение,
+    //если он возвращает bool, то false прекращает обход
+    //возвращают false, если обход был прерван посетителем
+    template <typename TVisitor>
+    bool prefix_traversal(TVisitor &&visitor) const;
+    template <typename TVisitor>
+    bool postfix_traversal(TVisitor &&visitor) const;
+    template <typename TVisitor>
+    bool infix_traversal(TVisitor &&visitor) const;
 
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    //первый элемент с ключом не меньше key, первый элемент с ключом больше key
+    //и диапазон элементов с ключом key
+    //как и поиск, вызывают хук поиска для последнего посещенного элемента
+    //(splay-дерево поднимает его в корень, константные версии форму дерева не меняют)
+    template <typename TOtherKey>
+    iterator lower_bound(const TOtherKey &key);
+    template <typename TOtherKey>
+    iterator upper_bound(const TOtherKey &key);
+    template <typename TOtherKey>
+    std::pair<iterator, iterator> equal_range(const TOtherKey &key);
+    template <typename TOtherKey>
+    const_iterator lower_bound(const TOtherKey &key) const;
+    template <typename TOtherKey>
+    const_iterator upper_bound(const TOtherKey &key) const;
+    template <typename TOtherKey>
+    std::pair<const_iterator, const_iterator> equal_range(const TOtherKey &key) const;
+    //порядковые статистики (только для структуры узла с размером поддерева, например sized_layout)
+    //элемент с номером index в порядке возрастания ключей (end(), если элементов не больше index)
+    //и количество элементов с ключом меньше key, обе операции выполняются за время спуска по дереву
+    //и, как поиск, вызывают хук поиска (splay-дерево поднимает найденный элемент в корень)
+    iterator select(size_t index);
+    template <typename TOtherKey>
+    size_t rank(const TOtherKey &key);
+    const_iterator select(size_t index) const;
+    template <typename TOtherKey>
+    size_t rank(const TOtherKey &key) const;
+protected:
+    //поиск границы (upper - строгой) с вызовом хука поиска для последнего посещенного элемента
+    template <typename TOtherKey>
+    iterator access_bound(const TOtherKey &key, bool upper);
+    //путь, от которого начинается поиск с подсказкой: путь hint, а для подсказки, построенной
+    //для другого корня, - путь position (итератора end()); position получает запомненные в hint границы
+    template <bool other_const>
+    const std::vector<node_type*> &hint_path(const tree_iterator<node_type, other_const> &hint, iterator &position) const;
+    //вставка и поиск с подсказкой от пути finger_path, результат строится в position
+    iterator finger_insert(iterator &position, const std::vector<node_type*> &finger_path, TKey key, TValue value);
+    iterator finger_find(iterator &position, const std::vector<node_type*> &finger_path, const TKey &key);
+    //новый лист insert_node подвешивается под последний узел пути path (с той стороны, куда ведет
+    //результат сравнения compare_result) и считается найденным: для него вызывается хук поиска
+    void attach_leaf(const std::vector<node_type*> &path, compare_t compare_result, node_type *insert_node);
+    //симметричный обход поддерева с корнем root_node без рекурсии
+    template <typename TVisitor>
+    static bool infix_traversal_base(node_type *root_node, TVisitor &visitor);
+    //уничтожение всех узлов поддерева за один итеративный проход
+    //возвращает количество уничтоженных узлов
+    size_t destroy_subtree(node_type *root_node);
+    //поузловое копирование поддерева (форма копии совпадает с формой исходного поддерева)
+    node_type *clone_subtree(const node_type *root_node);
+    //замена содержимого дерева копией содержимого другого дерева
+    template <typename TOtherMethods>
+    void copy_from(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TOtherMethods> &tree);
+    template <typename TIterator>
+    void assign_sorted_base(TIterator first, TIterator last, bool check_order);
+    //выгоднее ли применить пакет из batch_size элементов слиянием, чем отдельными операциями
+    bool is_merge_batch(size_t batch_size) const;
+    //упорядочивание элементов пакета по ключу (порядок равных ключей сохраняется)
+    //возвращает пары (итератор элемента, его номер в пакете)
+    template <typename TIterator, typename TKeyOf>
+    std::vector<std::pair<TIterator, size_t>> sort_batch(TIterator first, TIterator last, TKeyOf key_of) const;
+    node_type *root_node = nullptr;
+    //количество элементов; после разделения дерева без размеров поддеревьев оно неизвестно
+    //(count_known == false), и size() пересчитывает его при первом обращении
+    mutable size_t node_count = 0;
+    mutable bool count_known = true;
+    //компаратор хранится по значению, вызовы его оператора () встраиваются компилятором
+    TComparator key_comparator;
+    allocator_type allocator;
 };
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::find_error_exception::find_error_exception(TKey key)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find_error_exception::find_error_exception(const TOtherKey &key)
 {
     std::stringstream key_string;
     key_string << key;
@@ -270,16 +558,16 @@ binary_tree<TKey, TValue>::find_error_exception::find_error_exception(TKey key)
     set_exception_message(exception_message);
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::insert_error_exception::insert_error_exception(TKey key)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert_error_exception::insert_error_exception(const TKey &key)
 {
     std::stringstream key_string;
     key_string << key;
     set_exception_message("Insert error. Element with key \"" + key_string.str() + "\" already exists.");
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::remove_error_exception::remove_error_exception(TKey key)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::remove_error_exception::remove_error_exception(const TKey &key)
 {
     std::stringstream key_string;
     key_string << key;
@@ -287,451 +575,1411 @@ binary_tree<TKey, TValue>::remove_error_exception::remove_error_exception(TKey k
     set_exception_message(exception_message);
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::binary_tree()
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::order_error_exception::order_error_exception(const TKey &key)
 {
+    std::stringstream key_string;
+    key_string << key;
+    set_exception_message("Order error. Element with key \"" + key_string.str() + "\" breaks the ascending order.");
+}
 
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::binary_tree(const TComparator &key_comparator) : key_comparator(key_comparator)
+{
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::binary_tree(comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::binary_tree(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods> &tree) : binary_tree(tree.key_comparator)
+//конструктор копирования
 {
-    this->finder = new find_template_method;
-    this->inserter = new insert_template_method;
-    this->remover = new remove_template_method;
-    this->key_comparator = key_comparator;
+    copy_from(tree);
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::init_template_methods(find_template_method *finder,
-                                                insert_template_method *inserter,
-                                                remove_template_method *remover)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::binary_tree(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TOtherMethods> &tree) : binary_tree(tree.key_comparator)
 {
-    this->finder = finder;
-    this->inserter = inserter;
-    this->remover = remover;
+    copy_from(tree);
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::binary_tree(binary_tree<TKey, TValue> &tree) : binary_tree(tree.key_comparator)
-//конструктор копирования
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::binary_tree(binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods> &&tree) : binary_tree(tree.key_comparator)
+//конструктор перемещения
+//дерево-источник остается пустым, но пригодным к использованию
 {
-    std::vector<node<TKey, TValue>> nodes;
-    tree.prefix_traversal([&nodes](TKey key, TValue value, int depth) { nodes.push_back({ key, value }); });
-    for (size_t i = 0; i < nodes.size(); i++)
-    {
-        this->inserter->invoke_insert(this->root_node, nodes[i].key, nodes[i].value, this->key_comparator);
-    }
+    swap(tree);
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>::~binary_tree()
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::~binary_tree()
 {
-    std::vector<node<TKey, TValue>> nodes;
-    postfix_traversal([&nodes](TKey key, TValue value, int depth) { nodes.push_back({ key, value }); });
-    for (size_t i = 0; i < nodes.size(); i++)
-    {
-        this->remover->invoke_remove(this->root_node, nodes[i].key, this->key_comparator);
-    }
-    delete finder;
-    delete inserter;
-    delete remover;
+    clear();
 }
 
-template <typename TKey, typename TValue>
-binary_tree<TKey, TValue>& binary_tree<TKey, TValue>::operator = (const binary_tree &tree)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>& binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::operator = (const binary_tree &tree)
 //переопределение оператора присваивания
 {
-    std::vector<node<TKey, TValue>> nodes;
-    postfix_traversal([&nodes](TKey key, TValue value, int depth) { nodes.push_back({ key, value }); });
-    for (size_t i = 0; i < nodes.size(); i++)
-    {
-        this->remover->invoke_remove(this->root_node, nodes[i].key, this->key_comparator);
-    }
-    *(this->finder) = *(tree.finder);
-    *(this->inserter) = *(tree.inserter);
-    *(this->remover) = *(tree.remover);
-    *(this->key_comparator) = *(tree.key_comparator);
-    nodes.clear();
-    tree.prefix_traversal([&nodes](TKey key, TValue value, int depth) { nodes.push_back({ key, value }); });
-    for (size_t i = 0; i < nodes.size(); i++)
+    if (this == &tree)
     {
-        this->inserter->invoke_insert(this->root_node, nodes[i].key, nodes[i].value, this->key_comparator);
+        return *this;
     }
+    clear();
+    this->key_comparator = tree.key_comparator;
+    copy_from(tree);
     return *this;
 }
 
-template <typename TKey, typename TValue>
-TValue binary_tree<TKey, TValue>::find(TKey key)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+TValue binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find(const TKey &key)
 //метод поиска элемента в дереве
 //в нем вызывается декорирующий интерфейсный метод из класса шаблонного метода поиска
 {
-    node<TKey, TValue> *find_node = finder->invoke_find(this->root_node, key, this->key_comparator);
+    node_type *find_node = find_template_method::invoke_find(this->root_node, key, this->key_comparator, this->size());
     return find_node->value;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::insert(TKey key, TValue value)
-//метод вставки элемента в дерево
-//в нем вызывается декорирующий интерфейсный метод из класса шаблонного метода вставки
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+TValue *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::try_find(const TKey &key)
+//метод поиска элемента в дереве без исключений
 {
-    inserter->invoke_insert(this->root_node, key, value, this->key_comparator);
+    node_type *find_node = find_template_method::try_invoke_find(this->root_node, key, this->key_comparator, this->size());
+    return find_node ? &find_node->value : nullptr;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::remove(TKey key)
-//метод удаления элемента в дереве
-//в нем вызывается декорирующий интерфейсный метод из класса шаблонного метода удаления
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::contains(const TKey &key)
 {
-    remover->invoke_remove(this->root_node, key, this->key_comparator);
+    return find_template_method::try_invoke_find(this->root_node, key, this->key_comparator, this->size()) != nullptr;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::prefix_traversal(callback_function function) const
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+TValue binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find(const TOtherKey &key)
 {
-    prefix_traversal_base(root_node, function, 0);
+    node_type *find_node = find_template_method::try_invoke_find(this->root_node, key, this->key_comparator, this->size());
+    if (!find_node)
+    {
+        throw find_error_exception(key);
+    }
+    return find_node->value;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::postfix_traversal(callback_function function) const
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+TValue *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::try_find(const TOtherKey &key)
 {
-    postfix_traversal_base(root_node, function, 0);
+    node_type *find_node = find_template_method::try_invoke_find(this->root_node, key, this->key_comparator, this->size());
+    return find_node ? &find_node->value : nullptr;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::infix_traversal(callback_function function) const
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::contains(const TOtherKey &key)
 {
-    infix_traversal_base(root_node, function, 0);
+    return find_template_method::try_invoke_find(this->root_node, key, this->key_comparator, this->size()) != nullptr;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::prefix_traversal_base(node<TKey, TValue> *root_node,
-                                                      callback_function function,
-                                                      int depth) const
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <bool other_const>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert(const tree_iterator<node_type, other_const> &hint, TKey key, TValue value)
 {
-    if (root_node)
+    iterator position(this->root_node);
+    const std::vector<node_type*> &finger_path = hint_path(hint, position);
+    return finger_insert(position, finger_path, std::move(key), std::move(value));
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <bool other_const>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert(tree_iterator<node_type, other_const> &&hint, TKey key, TValue value)
+{
+    iterator position(this->root_node);
+    if (&hint_path(hint, position) == &hint.path)
+    //путь подсказки забирается без копирования
     {
-        function(root_node->key, root_node->value, depth);
-        if (root_node->left)
-        {
-            prefix_traversal_base(root_node->left, function, depth + 1);
-        }
-        if (root_node->right)
-        {
-            prefix_traversal_base(root_node->right, function, depth + 1);
-        }
+        position.path.swap(hint.path);
     }
+    return finger_insert(position, position.path, std::move(key), std::move(value));
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::postfix_traversal_base(node<TKey, TValue> *root_node,
-                                                       callback_function function,
-                                                       int depth) const
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <bool other_const>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find(const tree_iterator<node_type, other_const> &hint, const TKey &key)
 {
-    if (root_node)
+    iterator position(this->root_node);
+    const std::vector<node_type*> &finger_path = hint_path(hint, position);
+    return finger_find(position, finger_path, key);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <bool other_const>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find(tree_iterator<node_type, other_const> &&hint, const TKey &key)
+{
+    iterator position(this->root_node);
+    if (&hint_path(hint, position) == &hint.path)
     {
-        if (root_node->left)
-        {
-            postfix_traversal_base(root_node->left, function, depth + 1);
-        }
-        if (root_node->right)
-        {
-            postfix_traversal_base(root_node->right, function, depth + 1);
-        }
-        function(root_node->key, root_node->value, depth);
+        position.path.swap(hint.path);
     }
+    return finger_find(position, position.path, key);
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::infix_traversal_base(node<TKey, TValue> *roott_node,
-                                                     callback_function function,
-                                                     int depth) const
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::finger_insert(iterator &position, const std::vector<node_type*> &finger_path, TKey key, TValue value)
+//новый элемент становится листом под последним посещенным узлом (как в обычном бинарном дереве поиска),
+//после чего считается найденным: вызывается хук поиска (splay-дерево поднимает его в корень)
 {
-    if (roott_node)
+    compare_t compare_result = position.seek_finger(finger_path, key, this->key_comparator);
+    if (!position.path.empty() && compare_result == EQUAL)
+    //элемент с таким ключем уже существует
     {
-        if (roott_node->left)
-        {
-            infix_traversal_base(roott_node->left, function, depth + 1);
-        }
-        function(roott_node->key, roott_node->value, depth);
-        if (roott_node->right)
+        throw insert_error_exception(key);
+    }
+    node_type *insert_node = this->allocator.create(std::move(key), std::move(value));
+    attach_leaf(position.path, compare_result, insert_node);
+    position.root_node = this->root_node;
+    position.path.push_back(insert_node);
+    if (TMethods::find_restructures)
+    {
+        position.root_node = this->root_node;
+        position.seek(insert_node->key, this->key_comparator, false);
+    }
+    return std::move(position);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::finger_find(iterator &position, const std::vector<node_type*> &finger_path, const TKey &key)
+//хук вызывается для найденного элемента, а при его отсутствии - для последнего посещенного
+{
+    compare_t compare_result = position.seek_finger(finger_path, key, this->key_comparator);
+    if (position.path.empty())
+    //дерево пустое
+    {
+        return std::move(position);
+    }
+    node_type *last_node = position.path.back();
+    TMethods::post_find_hook(this->root_node, last_node, this->key_comparator, this->size());
+    if (compare_result != EQUAL)
+    {
+        return end();
+    }
+    if (TMethods::find_restructures)
+    {
+        position.root_node = this->root_node;
+        position.seek(key, this->key_comparator, false);
+    }
+    return std::move(position);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::attach_leaf(const std::vector<node_type*> &path, compare_t compare_result, node_type *insert_node)
+{
+    if (path.empty())
+    {
+        this->root_node = insert_node;
+    }
+    else if (compare_result == LESS)
+    {
+        path.back()->left = insert_node;
+    }
+    else
+    {
+        path.back()->right = insert_node;
+    }
+    if constexpr (node_traits<node_type>::has_size)
+    //новый элемент добавляется в поддеревья всех узлов пути
+    {
+        for (size_t i = 0; i < path.size(); i++)
         {
-            infix_traversal_base(roott_node->right, function, depth + 1);
+            path[i]->size++;
         }
     }
+    this->node_count++;
+    TMethods::post_find_hook(this->root_node, insert_node, this->key_comparator, this->size());
 }
 
-template <typename TKey, typename TValue>
-node<TKey, TValue>* binary_tree<TKey, TValue>::find_template_method::invoke_find(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+TValue binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find(const TKey &key) const
 {
-    node<TKey, TValue> *find_node = nullptr;
-    status_t status = inner_find(root_node, key, key_comparator, find_node);
-    if (status == FIND_ERROR)
+    const TValue *find_value = try_find(key);
+    if (!find_value)
     {
         throw find_error_exception(key);
     }
-    post_find_hook(root_node, find_node, key_comparator);
-    return find_node;
+    return *find_value;
 }
 
-template <typename TKey, typename TValue>
-status_t binary_tree<TKey, TValue>::find_template_method::inner_find(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        comparator<TKey> *key_comparator,
-        node<TKey, TValue> *&find_node)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+const TValue *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::try_find(const TKey &key) const
+//спуск обычного бинарного дерева поиска от копии корня
 {
-    node<TKey, TValue> *current_node = root_node;
-    while(current_node)
+    node_type *root_node = this->root_node;
+    node_type *find_node = nullptr;
+    if (bst_methods::inner_find(root_node, key, this->key_comparator, find_node, this->node_count) == FIND_ERROR)
     {
-        switch ((*key_comparator)(key, current_node->key)) {
-        case LESS:
-            //идем по левой стороне
-            current_node = current_node->left;
-            break;
-        case GREAT:
-            //идем по правой стороне
-            current_node = current_node->right;
-            break;
-        case EQUAL:
-            //нужный элемент найден
-            find_node = current_node;
-            return FIND_SUCCESS;
-            break;
-        }
+        return nullptr;
     }
-    //нужный элемент отсутствует
-    return FIND_ERROR;
+    return &find_node->value;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::find_template_method::post_find_hook(
-        node<TKey, TValue> *&root_node,
-        node<TKey, TValue> *&find_node,
-        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::contains(const TKey &key) const
 {
+    return try_find(key) != nullptr;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::insert_template_method::invoke_insert(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        TValue value,
-        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert(TKey key, TValue value)
+//метод вставки элемента в дерево
+//в нем вызывается декорирующий интерфейсный метод из класса шаблонного метода вставки
 {
-    node<TKey, TValue> *insert_node = new node<TKey, TValue>(key, value);
-    status_t status = inner_insert(root_node, key, value, key_comparator, insert_node);
-    if (status == INSERT_ERROR)
+    node_type *insert_node = this->allocator.create(std::move(key), std::move(value));
+    insert_template_method::invoke_insert(this->root_node, insert_node, this->key_comparator, this->allocator);
+    this->node_count++;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TKeyArg, typename... TValueArgs>
+TValue &binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::emplace(TKeyArg &&key, TValueArgs&&... value_args)
+//элемент конструируется прямо в узле из переданных аргументов
+{
+    node_type *insert_node = this->allocator.create(std::forward<TKeyArg>(key), std::forward<TValueArgs>(value_args)...);
+    insert_template_method::invoke_insert(this->root_node, insert_node, this->key_comparator, this->allocator);
+    this->node_count++;
+    return insert_node->value;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TKeyArg, typename... TValueArgs>
+std::pair<TValue*, bool> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::try_emplace(TKeyArg &&key, TValueArgs&&... value_args)
+//узел создается только если элемента с таким ключем еще нет
+//один спуск от корня: найденный элемент или новый лист на месте промаха считается найденным
+{
+    iterator position(this->root_node);
+    compare_t compare_result = position.seek_finger(position.path, key, this->key_comparator);
+    if (!position.path.empty() && compare_result == EQUAL)
     {
-        throw insert_error_exception(key);
+        node_type *find_node = position.path.back();
+        TMethods::post_find_hook(this->root_node, find_node, this->key_comparator, this->size());
+        return std::make_pair(&find_node->value, false);
     }
-    post_insert_hook(root_node, insert_node, key_comparator);
+    node_type *insert_node = this->allocator.create(std::forward<TKeyArg>(key), std::forward<TValueArgs>(value_args)...);
+    attach_leaf(position.path, compare_result, insert_node);
+    return std::make_pair(&insert_node->value, true);
 }
 
-template <typename TKey, typename TValue>
-status_t binary_tree<TKey, TValue>::insert_template_method::inner_insert(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        TValue value,
-        comparator<TKey> *key_comparator,
-        node<TKey, TValue> *&insert_node)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::remove(const TKey &key)
+//метод удаления элемента в дереве
+//в нем вызывается декорирующий интерфейсный метод из класса шаблонного метода удаления
 {
-    if (!root_node)
+    remove_template_method::invoke_remove(this->root_node, key, this->key_comparator, this->allocator);
+    this->node_count--;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::try_remove(const TKey &key)
+{
+    if (remove_template_method::try_invoke_remove(this->root_node, key, this->key_comparator, this->allocator) == REMOVE_ERROR)
     {
-        root_node = insert_node;
+        return false;
     }
-    else
+    this->node_count--;
+    return true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>& binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::operator = (binary_tree &&tree)
+//переопределение оператора присваивания перемещением
+{
+    if (this != &tree)
     {
-        node<TKey, TValue> *current_node = root_node;
-        node<TKey, TValue> *parent_node = nullptr;
-        compare_t compare_result;
-        while (current_node)
-        {
-            compare_result = (*key_comparator)(insert_node->key, current_node->key);
-            parent_node = current_node;
-            if (compare_result == LESS)
-            //идем по левой стороне
-            {
-                current_node = current_node->left;
-            }
-            else if (compare_result == GREAT)
-            //идем по правой стороне
-            {
-                current_node = current_node->right;
-            }
-            else if (compare_result == EQUAL)
-            //элемент с таким ключем уже существует
-            {
-                return INSERT_ERROR;
-            }
-        }
-        compare_result = (*key_comparator)(insert_node->key, parent_node->key);
-        if (compare_result == LESS)
-        //если ключ вставляемого элемента меньше ключа предка, вставляем слева
-        {
-            parent_node->left = insert_node;
-        }
-        else if (compare_result == GREAT)
-        //если ключ вставляемого элемента больше ключа предка, вставляем справа
-        {
-            parent_node->right = insert_node;
-        }
+        clear();
+        swap(tree);
     }
-    return INSERT_SUCCESS;
+    return *this;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::insert_template_method::post_insert_hook(
-        node<TKey, TValue> *&root_node,
-        node<TKey, TValue> *&insert_node,
-        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::swap(binary_tree &tree)
+//обмениваются корни, компараторы и распределители узлов
 {
+    std::swap(this->root_node, tree.root_node);
+    std::swap(this->node_count, tree.node_count);
+    std::swap(this->count_known, tree.count_known);
+    std::swap(this->key_comparator, tree.key_comparator);
+    this->allocator.swap(tree.allocator);
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::remove_template_method::invoke_remove(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::select(size_t index)
 {
-    status_t status = inner_remove(root_node, key, key_comparator);
-    if (status == REMOVE_ERROR)
+    static_assert(node_traits<node_type>::has_size, "select() requires a node layout with subtree sizes");
+    iterator position(this->root_node);
+    node_type *select_node = position.seek_index(index);
+    if (select_node)
     {
-        throw remove_error_exception(key);
+        TMethods::post_find_hook(this->root_node, select_node, this->key_comparator, this->size());
+        if (TMethods::find_restructures)
+        {
+            position.root_node = this->root_node;
+            position.seek_index(index);
+        }
     }
-    post_remove_hook(root_node, key_comparator);
+    return position;
 }
 
-template <typename TKey, typename TValue>
-status_t binary_tree<TKey, TValue>::remove_template_method::inner_remove(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+size_t binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::rank(const TOtherKey &key)
 {
-    node<TKey, TValue> *replace_node = nullptr;
-    node<TKey, TValue> *replace_parent_node = nullptr;
-    node<TKey, TValue> *current_node = root_node;
-    node<TKey, TValue> *remove_node = nullptr;
-    remove_node = bst::find_remove_node(root_node, key, key_comparator);
-    if (!remove_node)
-    //удаляемый элемент отсутствует
+    static_assert(node_traits<node_type>::has_size, "rank() requires a node layout with subtree sizes");
+    size_t count = 0;
+    node_type *current_node = this->root_node;
+    node_type *last_node = nullptr;
+    while (current_node)
     {
-        return REMOVE_ERROR;
-    }
-    if (remove_node->left && remove_node->right)
-    //удаляемый элемент имеет двоих потомков
-    {
-        replace_node = bst::find_min_node(remove_node->right);
-        replace_parent_node = bst::get_parent(root_node, replace_node, key_comparator);
-        //переносим значения из заменяющего элемента в удаляемый элемент
-        remove_node->key = replace_node->key;
-        remove_node->value = replace_node->value;
-        //теперь заменяющий элемент становится удаляемым
-        remove_node = replace_node;
-        //и его нужно удалить
-        if (remove_node->right)
-        //заменяющий (удаляемый) элемент имеет правого потомка
-        {
-            replace_node = remove_node->right;
-            if (remove_node == replace_parent_node->right)
-            {
-                replace_parent_node->right = replace_node;
-            }
-            else
-            {
-                replace_parent_node->left = replace_node;
-            }
-        }
-        else
-        //заменяющий (удаляемый) элемент не имеет потомков
+        last_node = current_node;
+        compare_t compare_result = this->key_comparator(key, current_node->key);
+        if (compare_result == GREAT)
+        //текущий элемент и его левое поддерево меньше key
         {
-            replace_node = nullptr;
-            if (remove_node == replace_parent_node->left)
-            {
-                replace_parent_node->left = replace_node;
-            }
-            else
-            {
-                replace_parent_node->right = replace_node;
-            }
+            count += node_traits<node_type>::size(current_node->left) + 1;
+            current_node = current_node->right;
         }
-    }
-    else if (remove_node->left)
-    //удаляемый элемент имеет только левого потомка
-    {
-        replace_node = remove_node->left;
-        if (bst::get_parent(root_node, remove_node, key_comparator))
-        //удаляемый элемент не корневой (имеет предка)
+        else if (compare_result == EQUAL)
         {
-            if (remove_node == bst::get_left(bst::get_parent(root_node, remove_node, key_comparator)))
-            {
-                bst::get_parent(root_node, remove_node, key_comparator)->left = replace_node;
-            }
-            else
-            {
-                bst::get_parent(root_node, remove_node, key_comparator)->right = replace_node;
-            }
+            count += node_traits<node_type>::size(current_node->left);
+            break;
         }
         else
-        //удаляемый элемент корневой
         {
-            root_node = replace_node;
+            current_node = current_node->left;
         }
     }
-    else if (remove_node->right)
-    //удаляемый элемент имеет только правого потомка
+    if (last_node)
     {
-        replace_node = remove_node->right;
-        if (bst::get_parent(root_node, remove_node, key_comparator))
-        //удаляемый элемент не корневой (имеет предка)
+        TMethods::post_find_hook(this->root_node, last_node, this->key_comparator, this->size());
+    }
+    return count;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::select(size_t index) const
+{
+    static_assert(node_traits<node_type>::has_size, "select() requires a node layout with subtree sizes");
+    const_iterator position(this->root_node);
+    position.seek_index(index);
+    return position;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+size_t binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::rank(const TOtherKey &key) const
+{
+    static_assert(node_traits<node_type>::has_size, "rank() requires a node layout with subtree sizes");
+    size_t count = 0;
+    node_type *current_node = this->root_node;
+    while (current_node)
+    {
+        compare_t compare_result = this->key_comparator(key, current_node->key);
+        if (compare_result == GREAT)
         {
-            if (remove_node == bst::get_right(bst::get_parent(root_node, remove_node, key_comparator)))
-            {
-                bst::get_parent(root_node, remove_node, key_comparator)->right = replace_node;
-            }
-            else
-            {
-                bst::get_parent(root_node, remove_node, key_comparator)->left = replace_node;
-            }
+            count += node_traits<node_type>::size(current_node->left) + 1;
+            current_node = current_node->right;
+        }
+        else if (compare_result == EQUAL)
+        {
+            count += node_traits<node_type>::size(current_node->left);
+            break;
         }
         else
-        //удаляемый элемент корневой
         {
-            root_node = replace_node;
+            current_node = current_node->left;
         }
     }
-    else
-    //удаляемый элемент не имеет потомков
-    {
-        if (bst::get_parent(root_node, remove_node, key_comparator))
-        //удаляемый элемент не корневой (имеет предка)
-        {
-            if (remove_node == bst::get_left(bst::get_parent(root_node, remove_node, key_comparator)))
+    return count;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::clear()
+//метод удаления всех элементов дерева
+//узлы освобождаются за один проход без перебалансировки и копирования ключей
+{
+    if (!(allocator_type::bulk_release && std::is_trivially_destructible<node_type>::value))
+    //узлы нужно уничтожить по одному
+    {
+        destroy_subtree(this->root_node);
+    }
+    if (allocator_type::bulk_release)
+    //распределитель освобождает память всех узлов разом
+    {
+        this->allocator.release();
+    }
+    this->root_node = nullptr;
+    this->node_count = 0;
+    this->count_known = true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+size_t binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::destroy_subtree(node_type *root_node)
+{
+    size_t destroy_count = 0;
+    node_type *current_node = root_node;
+    while (current_node)
+    {
+        if (current_node->left)
+        //поворачиваем направо, чтобы у текущего узла не осталось левого потомка
+        //(стек и рекурсия не нужны, каждый узел поворачивается не более одного раза)
+        {
+            node_type *left_node = current_node->left;
+            current_node->left = left_node->right;
+            left_node->right = current_node;
+            current_node = left_node;
+        }
+        else
+        //левого потомка нет, удаляем узел и переходим к правому поддереву
+        {
+            node_type *right_node = current_node->right;
+            this->allocator.destroy(current_node);
+            destroy_count++;
+            current_node = right_node;
+        }
+    }
+    return destroy_count;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::node_type *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::clone_subtree(const node_type *root_node)
+//копия строится за O(n) без сравнений ключей, явный стек хранит пары
+//(исходный узел, его копия), у которых еще не скопировано правое поддерево
+{
+    if (!root_node)
+    {
+        return nullptr;
+    }
+    std::vector<std::pair<const node_type*, node_type*>> pending;
+    node_type *clone_root = nullptr;
+    try
+    {
+        //копия узла получает все поля исходного узла, ссылки на потомков заполняются ниже
+        clone_root = this->allocator.create(*root_node);
+        clone_root->left = nullptr;
+        clone_root->right = nullptr;
+        const node_type *source_node = root_node;
+        node_type *clone_node = clone_root;
+        while (true)
+        {
+            if (source_node->right)
+            {
+                pending.push_back(std::make_pair(source_node, clone_node));
+            }
+            if (source_node->left)
+            //спускаемся влево, копируя узлы
+            {
+                source_node = source_node->left;
+                clone_node->left = this->allocator.create(*source_node);
+                clone_node = clone_node->left;
+                clone_node->left = nullptr;
+                clone_node->right = nullptr;
+            }
+            else if (!pending.empty())
+            //левая ветвь закончилась, переходим к ближайшему нескопированному правому поддереву
+            {
+                source_node = pending.back().first->right;
+                clone_node = pending.back().second;
+                pending.pop_back();
+                clone_node->right = this->allocator.create(*source_node);
+                clone_node = clone_node->right;
+                clone_node->left = nullptr;
+                clone_node->right = nullptr;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+    catch (...)
+    //не удалось выделить узел, уничтожаем уже построенную часть копии
+    {
+        destroy_subtree(clone_root);
+        throw;
+    }
+    return clone_root;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::copy_from(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TOtherMethods> &tree)
+{
+    clear();
+    this->root_node = clone_subtree(tree.root_node);
+    this->node_count = tree.node_count;
+    this->count_known = tree.count_known;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::assign_sorted(TIterator first, TIterator last)
+{
+    assign_sorted_base(first, last, false);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::assign_sorted_checked(TIterator first, TIterator last)
+{
+    assign_sorted_base(first, last, true);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+frozen_tree<TKey, TValue, TComparator> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::freeze() const
+{
+    std::vector<std::pair<TKey, TValue>> sorted;
+    sorted.reserve(size());
+    auto collector = [&sorted](const TKey &key, const TValue &value, int)
+    {
+        sorted.emplace_back(key, value);
+    };
+    infix_traversal_base(this->root_node, collector);
+    return frozen_tree<TKey, TValue, TComparator>(sorted.begin(), sorted.end(), this->key_comparator);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::assign_sorted_base(TIterator first, TIterator last, bool check_order)
+{
+    clear();
+    //узлы создаются по порядку и связываются в "лозу" правыми ссылками
+    node_type *head_node = nullptr;
+    node_type *tail_node = nullptr;
+    size_t count = 0;
+    try
+    {
+        for (; first != last; ++first)
+        {
+            node_type *new_node = this->allocator.create(first->first, first->second);
+            if (tail_node)
+            {
+                tail_node->right = new_node;
+            }
+            else
+            {
+                head_node = new_node;
+            }
+            if (check_order && tail_node && this->key_comparator(tail_node->key, new_node->key) != LESS)
+            //ключ не больше ключа предыдущего элемента
+            {
+                throw order_error_exception(new_node->key);
+            }
+            tail_node = new_node;
+            count++;
+        }
+    }
+    catch (...)
+    {
+        destroy_subtree(head_node);
+        throw;
+    }
+    bst::vine_to_tree(head_node, count);
+    this->root_node = head_node;
+    this->node_count = count;
+    this->count_known = true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+size_t binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::size() const
+{
+    if (!this->count_known)
+    //количество элементов неизвестно, считаем их одним обходом
+    {
+        size_t count = 0;
+        auto counter = [&count](const TKey &, const TValue &, int)
+        {
+            count++;
+        };
+        infix_traversal_base(this->root_node, counter);
+        this->node_count = count;
+        this->count_known = true;
+    }
+    return this->node_count;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::empty() const
+{
+    return !this->root_node;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::is_merge_batch(size_t batch_size) const
+//слияние стоит O(n + m), а m отдельных операций - O(m log n)
+{
+    size_t tree_size = size();
+    size_t height = 1;
+    for (size_t count = tree_size; count > 1; count >>= 1)
+    {
+        height++;
+    }
+    return batch_size * height >= tree_size;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator, typename TKeyOf>
+std::vector<std::pair<TIterator, size_t>> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::sort_batch(TIterator first, TIterator last, TKeyOf key_of) const
+{
+    std::vector<std::pair<TIterator, size_t>> batch;
+    for (size_t i = 0; first != last; ++first, i++)
+    {
+        batch.push_back(std::make_pair(first, i));
+    }
+    const TComparator &key_comparator = this->key_comparator;
+    std::stable_sort(batch.begin(), batch.end(), [&key_comparator, &key_of](const std::pair<TIterator, size_t> &item_1,
+                                                                          const std::pair<TIterator, size_t> &item_2)
+    {
+        return key_comparator(key_of(item_1.first), key_of(item_2.first)) == LESS;
+    });
+    return batch;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator>
+std::vector<status_t> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert_many(TIterator first, TIterator last)
+{
+    std::vector<status_t> status;
+    auto key_of = [](const TIterator &item) -> const TKey & { return item->first; };
+    std::vector<std::pair<TIterator, size_t>> batch = sort_batch(first, last, key_of);
+    status.resize(batch.size(), INSERT_ERROR);
+    if (!is_merge_batch(batch.size()))
+    //пакет мал относительно дерева: отдельные вставки в порядке возрастания ключей
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            node_type *insert_node = this->allocator.create(batch[i].first->first, batch[i].first->second);
+            status[batch[i].second] = insert_template_method::try_invoke_insert(this->root_node, insert_node, this->key_comparator, this->allocator);
+            if (status[batch[i].second] == INSERT_SUCCESS)
+            {
+                this->node_count++;
+            }
+        }
+        return status;
+    }
+    //вытягиваем дерево в упорядоченную лозу и вливаем в нее пакет
+    size_t count = bst::tree_to_vine(this->root_node);
+    node_type *previous_node = nullptr;
+    node_type *current_node = this->root_node;
+    try
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            const TKey &key = batch[i].first->first;
+            while (current_node && this->key_comparator(current_node->key, key) == LESS)
+            {
+                previous_node = current_node;
+                current_node = current_node->right;
+            }
+            if ((current_node && this->key_comparator(key, current_node->key) == EQUAL) ||
+                (previous_node && this->key_comparator(key, previous_node->key) == EQUAL))
+            //элемент с таким ключем уже есть в дереве или встречался в пакете раньше
             {
-                bst::get_parent(root_node, remove_node, key_comparator)->left = replace_node;
+                continue;
+            }
+            node_type *insert_node = this->allocator.create(batch[i].first->first, batch[i].first->second);
+            insert_node->right = current_node;
+            if (previous_node)
+            {
+                previous_node->right = insert_node;
             }
             else
             {
-                bst::get_parent(root_node, remove_node, key_comparator)->right = replace_node;
+                this->root_node = insert_node;
             }
+            previous_node = insert_node;
+            count++;
+            status[batch[i].second] = INSERT_SUCCESS;
+        }
+    }
+    catch (...)
+    //лоза остается корректным деревом, восстанавливаем баланс и пробрасываем исключение
+    {
+        bst::vine_to_tree(this->root_node, count);
+        this->node_count = count;
+        this->count_known = true;
+        throw;
+    }
+    bst::vine_to_tree(this->root_node, count);
+    this->node_count = count;
+    this->count_known = true;
+    return status;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator>
+std::vector<status_t> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::remove_many(TIterator first, TIterator last)
+{
+    std::vector<status_t> status;
+    auto key_of = [](const TIterator &item) -> const TKey & { return *item; };
+    std::vector<std::pair<TIterator, size_t>> batch = sort_batch(first, last, key_of);
+    status.resize(batch.size(), REMOVE_ERROR);
+    if (!is_merge_batch(batch.size()))
+    //пакет мал относительно дерева: отдельные удаления в порядке возрастания ключей
+    {
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            status[batch[i].second] = remove_template_method::try_invoke_remove(this->root_node, *batch[i].first, this->key_comparator, this->allocator);
+            if (status[batch[i].second] == REMOVE_SUCCESS)
+            {
+                this->node_count--;
+            }
+        }
+        return status;
+    }
+    //вытягиваем дерево в упорядоченную лозу и вырезаем из нее элементы пакета
+    size_t count = bst::tree_to_vine(this->root_node);
+    node_type *previous_node = nullptr;
+    node_type *current_node = this->root_node;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const TKey &key = *batch[i].first;
+        while (current_node && this->key_comparator(current_node->key, key) == LESS)
+        {
+            previous_node = current_node;
+            current_node = current_node->right;
+        }
+        if (!current_node || this->key_comparator(key, current_node->key) != EQUAL)
+        //удаляемый элемент отсутствует
+        {
+            continue;
+        }
+        node_type *next_node = current_node->right;
+        if (previous_node)
+        {
+            previous_node->right = next_node;
         }
         else
-        //удаляемый элемент корневой
         {
-            root_node = replace_node;
+            this->root_node = next_node;
         }
+        this->allocator.destroy(current_node);
+        current_node = next_node;
+        count--;
+        status[batch[i].second] = REMOVE_SUCCESS;
+    }
+    bst::vine_to_tree(this->root_node, count);
+    this->node_count = count;
+    this->count_known = true;
+    return status;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TIterator>
+std::vector<status_t> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find_many(TIterator first, TIterator last, std::vector<TValue*> &values)
+{
+    auto key_of = [](const TIterator &item) -> const TKey & { return *item; };
+    std::vector<std::pair<TIterator, size_t>> batch = sort_batch(first, last, key_of);
+    std::vector<status_t> status(batch.size(), FIND_ERROR);
+    values.assign(batch.size(), nullptr);
+    //последние посещенные (при попадании - найденные) узлы в порядке возрастания ключей
+    std::vector<node_type*> visited_nodes(batch.size(), nullptr);
+    //путь от корня до последнего посещенного узла
+    std::vector<node_type*> path;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        const TKey &key = *batch[i].first;
+        //поднимаемся по пути, пока ключ не попадет в диапазон ключей поддерева:
+        //ключи пакета не убывают, поэтому проверяется только верхняя граница, а она меняется
+        //лишь там, где путь поворачивал налево
+        size_t depth = path.size();
+        while (depth > 1)
+        {
+            node_type *parent_node = path[depth - 2];
+            if (static_cast<node_type*>(parent_node->left) == path[depth - 1] &&
+                this->key_comparator(key, parent_node->key) == LESS)
+            {
+                break;
+            }
+            depth--;
+        }
+        node_type *current_node = depth ? path[depth - 1] : this->root_node;
+        path.resize(depth ? depth - 1 : 0);
+        //обычный спуск от найденного поддерева
+        while (current_node)
+        {
+            path.push_back(current_node);
+            compare_t compare_result = this->key_comparator(key, current_node->key);
+            if (compare_result == EQUAL)
+            {
+                values[batch[i].second] = &current_node->value;
+                status[batch[i].second] = FIND_SUCCESS;
+                break;
+            }
+            current_node = (compare_result == LESS) ? current_node->left : current_node->right;
+        }
+        if (!path.empty())
+        {
+            visited_nodes[i] = path.back();
+        }
+    }
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        node_type *visited_node = visited_nodes[i];
+        if (visited_node)
+        {
+            TMethods::post_find_hook(this->root_node, visited_node, this->key_comparator, this->size());
+        }
+    }
+    return status;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::begin()
+{
+    iterator position(this->root_node);
+    position.push_min(this->root_node);
+    return position;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::end()
+{
+    return iterator(this->root_node);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::begin() const
+{
+    const_iterator position(this->root_node);
+    position.push_min(this->root_node);
+    return position;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::end() const
+{
+    return const_iterator(this->root_node);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::access_bound(const TOtherKey &key, bool upper)
+//если хук меняет форму дерева, граница ищется заново от корня
+//(после splay она находится рядом с корнем)
+{
+    iterator position(this->root_node);
+    node_type *last_node = position.seek(key, this->key_comparator, upper);
+    if (last_node)
+    {
+        TMethods::post_find_hook(this->root_node, last_node, this->key_comparator, this->size());
+        if (TMethods::find_restructures)
+        {
+            position.root_node = this->root_node;
+            position.seek(key, this->key_comparator, upper);
+        }
+    }
+    return position;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <bool other_const>
+const std::vector<typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::node_type*> &binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::hint_path(const tree_iterator<node_type, other_const> &hint, iterator &position) const
+{
+    if (hint.root_node != this->root_node)
+    {
+        return position.path;
+    }
+    position.finger_node = hint.finger_node;
+    position.finger_depth = hint.finger_depth;
+    position.finger_upper = hint.finger_upper;
+    position.finger_lower = hint.finger_lower;
+    return hint.path;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::lower_bound(const TOtherKey &key)
+{
+    return access_bound(key, false);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::upper_bound(const TOtherKey &key)
+{
+    return access_bound(key, true);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+std::pair<typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator, typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::iterator> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::equal_range(const TOtherKey &key)
+//хук вызывается один раз, вторая граница ищется в уже перестроенном дереве
+{
+    iterator first = access_bound(key, false);
+    iterator last(this->root_node);
+    last.seek(key, this->key_comparator, true);
+    return std::make_pair(first, last);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::lower_bound(const TOtherKey &key) const
+{
+    const_iterator position(this->root_node);
+    position.seek(key, this->key_comparator, false);
+    return position;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::upper_bound(const TOtherKey &key) const
+{
+    const_iterator position(this->root_node);
+    position.seek(key, this->key_comparator, true);
+    return position;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+std::pair<typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator, typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::const_iterator> binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::equal_range(const TOtherKey &key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TVisitor>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::prefix_traversal(TVisitor &&visitor) const
+{
+    //стек узлов, ожидающих посещения, вместе с их глубиной
+    std::vector<std::pair<node_type*, int>> stack;
+    if (root_node)
+    {
+        stack.push_back(std::make_pair(root_node, 0));
+    }
+    while (!stack.empty())
+    {
+        node_type *current_node = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        if (!bst::visit(visitor, current_node->key, current_node->value, depth))
+        {
+            return false;
+        }
+        //правое поддерево кладется в стек первым, чтобы левое было обойдено раньше
+        if (current_node->right)
+        {
+            stack.push_back(std::make_pair(static_cast<node_type*>(current_node->right), depth + 1));
+        }
+        if (current_node->left)
+        {
+            stack.push_back(std::make_pair(static_cast<node_type*>(current_node->left), depth + 1));
+        }
+    }
+    return true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TVisitor>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::postfix_traversal(TVisitor &&visitor) const
+{
+    //стек предков текущего узла вместе с их глубиной
+    std::vector<std::pair<node_type*, int>> stack;
+    node_type *current_node = root_node;
+    node_type *last_node = nullptr;
+    int depth = 0;
+    while (current_node || !stack.empty())
+    {
+        if (current_node)
+        //спускаемся по левой стороне
+        {
+            stack.push_back(std::make_pair(current_node, depth));
+            current_node = current_node->left;
+            depth++;
+            continue;
+        }
+        node_type *top_node = stack.back().first;
+        node_type *right_node = top_node->right;
+        if (right_node && right_node != last_node)
+        //правое поддерево еще не обойдено
+        {
+            current_node = right_node;
+            depth = stack.back().second + 1;
+            continue;
+        }
+        //оба поддерева обойдены, посещаем сам узел
+        if (!bst::visit(visitor, top_node->key, top_node->value, stack.back().second))
+        {
+            return false;
+        }
+        last_node = top_node;
+        stack.pop_back();
+    }
+    return true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TVisitor>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::infix_traversal(TVisitor &&visitor) const
+{
+    return infix_traversal_base(root_node, visitor);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TVisitor>
+bool binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::infix_traversal_base(node_type *root_node, TVisitor &visitor)
+{
+    //стек предков текущего узла, левое поддерево которых обходится, вместе с их глубиной
+    std::vector<std::pair<node_type*, int>> stack;
+    node_type *current_node = root_node;
+    int depth = 0;
+    while (current_node || !stack.empty())
+    {
+        if (current_node)
+        //спускаемся по левой стороне
+        {
+            stack.push_back(std::make_pair(current_node, depth));
+            current_node = current_node->left;
+            depth++;
+            continue;
+        }
+        current_node = stack.back().first;
+        depth = stack.back().second;
+        stack.pop_back();
+        if (!bst::visit(visitor, current_node->key, current_node->value, depth))
+        {
+            return false;
+        }
+        current_node = current_node->right;
+        depth++;
+    }
+    return true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::node_type *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find_template_method::invoke_find(
+        node_type *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        size_t node_count)
+{
+    node_type *find_node = try_invoke_find(root_node, key, key_comparator, node_count);
+    if (!find_node)
+    {
+        throw find_error_exception(key);
+    }
+    return find_node;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::node_type *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find_template_method::try_invoke_find(
+        node_type *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        size_t node_count)
+{
+    node_type *find_node = nullptr;
+    status_t status = TMethods::inner_find(root_node, key, key_comparator, find_node, node_count);
+    if (status == FIND_ERROR)
+    {
+        return nullptr;
+    }
+    TMethods::post_find_hook(root_node, find_node, key_comparator, node_count);
+    return find_node;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+template <typename TOtherKey>
+typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::node_type *binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::find_template_method::try_invoke_find(
+        node_type *&root_node,
+        const TOtherKey &key,
+        const TComparator &key_comparator,
+        size_t node_count)
+{
+    node_type *current_node = root_node;
+    node_type *last_node = nullptr;
+    while (current_node)
+    {
+        last_node = current_node;
+        switch (key_comparator(key, current_node->key)) {
+        case LESS:
+            //идем по левой стороне
+            current_node = current_node->left;
+            break;
+        case GREAT:
+            //идем по правой стороне
+            current_node = current_node->right;
+            break;
+        case EQUAL:
+            //нужный элемент найден
+            TMethods::post_find_hook(root_node, current_node, key_comparator, node_count);
+            return current_node;
+        }
+    }
+    //нужный элемент отсутствует
+    if (last_node)
+    {
+        TMethods::post_find_hook(root_node, last_node, key_comparator, node_count);
+    }
+    return nullptr;
+}
+
+template <typename TNode, typename TKey, typename TComparator>
+status_t bst_methods::inner_find(
+        TNode *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        TNode *&find_node,
+        size_t /*node_count*/)
+{
+    TNode *current_node = root_node;
+    while(current_node)
+    {
+        switch (key_comparator(key, current_node->key)) {
+        case LESS:
+            //идем по левой стороне
+            current_node = current_node->left;
+            break;
+        case GREAT:
+            //идем по правой стороне
+            current_node = current_node->right;
+            break;
+        case EQUAL:
+            //нужный элемент найден
+            find_node = current_node;
+            return FIND_SUCCESS;
+            break;
+        }
+    }
+    //нужный элемент отсутствует
+    return FIND_ERROR;
+}
+
+template <typename TNode, typename TComparator>
+void bst_methods::post_find_hook(
+        TNode *& /*root_node*/,
+        TNode *& /*find_node*/,
+        const TComparator & /*key_comparator*/,
+        size_t /*node_count*/)
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert_template_method::invoke_insert(
+        node_type *&root_node,
+        node_type *insert_node,
+        const TComparator &key_comparator,
+        allocator_type &allocator)
+{
+    status_t status = TMethods::inner_insert(root_node, key_comparator, insert_node);
+    if (status == INSERT_ERROR)
+    {
+        //ключ нужен сообщению об ошибке, поэтому узел уничтожается после создания исключения
+        insert_error_exception exception(insert_node->key);
+        allocator.destroy(insert_node);
+        throw exception;
+    }
+    TMethods::post_insert_hook(root_node, insert_node, key_comparator);
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+status_t binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::insert_template_method::try_invoke_insert(
+        node_type *&root_node,
+        node_type *insert_node,
+        const TComparator &key_comparator,
+        allocator_type &allocator)
+{
+    status_t status = TMethods::inner_insert(root_node, key_comparator, insert_node);
+    if (status == INSERT_ERROR)
+    {
+        allocator.destroy(insert_node);
+        return status;
+    }
+    TMethods::post_insert_hook(root_node, insert_node, key_comparator);
+    return status;
+}
+
+template <typename TNode, typename TComparator>
+status_t bst_methods::inner_insert(
+        TNode *&root_node,
+        const TComparator &key_comparator,
+        TNode *&insert_node)
+{
+    if (!root_node)
+    {
+        root_node = insert_node;
+    }
+    else
+    {
+        TNode *current_node = root_node;
+        TNode *parent_node = nullptr;
+        compare_t compare_result;
+        while (current_node)
+        {
+            compare_result = key_comparator(insert_node->key, current_node->key);
+            parent_node = current_node;
+            if (compare_result == LESS)
+            //идем по левой стороне
+            {
+                current_node = current_node->left;
+            }
+            else if (compare_result == GREAT)
+            //идем по правой стороне
+            {
+                current_node = current_node->right;
+            }
+            else if (compare_result == EQUAL)
+            //элемент с таким ключем уже существует
+            {
+                return INSERT_ERROR;
+            }
+        }
+        compare_result = key_comparator(insert_node->key, parent_node->key);
+        if (compare_result == LESS)
+        //если ключ вставляемого элемента меньше ключа предка, вставляем слева
+        {
+            parent_node->left = insert_node;
+        }
+        else if (compare_result == GREAT)
+        //если ключ вставляемого элемента больше ключа предка, вставляем справа
+        {
+            parent_node->right = insert_node;
+        }
+        bst::add_path_size(root_node, insert_node->key, key_comparator, 1);
+    }
+    return INSERT_SUCCESS;
+}
+
+template <typename TNode, typename TComparator>
+void bst_methods::post_insert_hook(
+        TNode *& /*root_node*/,
+        TNode *& /*insert_node*/,
+        const TComparator & /*key_comparator*/)
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+void binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::remove_template_method::invoke_remove(
+        node_type *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        allocator_type &allocator)
+{
+    if (try_invoke_remove(root_node, key, key_comparator, allocator) == REMOVE_ERROR)
+    {
+        throw remove_error_exception(key);
+    }
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+status_t binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TMethods>::remove_template_method::try_invoke_remove(
+        node_type *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        allocator_type &allocator)
+{
+    status_t status = TMethods::inner_remove(root_node, key, key_comparator, allocator);
+    if (status == REMOVE_ERROR)
+    {
+        return status;
+    }
+    TMethods::post_remove_hook(root_node, key_comparator);
+    return status;
+}
+
+template <typename TNode, typename TKey, typename TComparator, typename TNodeAllocator>
+status_t bst_methods::inner_remove(
+        TNode *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        TNodeAllocator &allocator)
+//удаление за один спуск: запоминаем предка удаляемого элемента и сторону, с которой он висит,
+//а затем предка заменяющего элемента, поэтому повторные проходы от корня не нужны
+{
+    TNode *remove_node = root_node;
+    TNode *parent_node = nullptr;
+    compare_t compare_result = EQUAL;
+    while (remove_node)
+    //ищем удаляемый элемент
+    {
+        compare_t current_result = key_comparator(key, remove_node->key);
+        if (current_result == EQUAL)
+        {
+            break;
+        }
+        //поддеревья всех предков удаляемого элемента уменьшатся на один элемент
+        //(если элемента нет, уменьшение отменяется ниже)
+        if constexpr (node_traits<TNode>::has_size)
+        {
+            remove_node->size--;
+        }
+        parent_node = remove_node;
+        compare_result = current_result;
+        remove_node = (current_result == LESS) ? remove_node->left : remove_node->right;
+    }
+    if (!remove_node)
+    //удаляемый элемент отсутствует
+    {
+        bst::add_path_size(root_node, key, key_comparator, 1);
+        return REMOVE_ERROR;
+    }
+    TNode *replace_node = nullptr;
+    if (!remove_node->left)
+    //удаляемый элемент не имеет левого потомка, его место занимает правый
+    {
+        replace_node = remove_node->right;
+    }
+    else if (!remove_node->right)
+    //удаляемый элемент имеет только левого потомка
+    {
+        replace_node = remove_node->left;
+    }
+    else
+    //удаляемый элемент имеет двоих потомков: его место занимает минимальный элемент
+    //правого поддерева, который переносится целиком (ключ и значение не копируются)
+    {
+        TNode *replace_parent_node = remove_node;
+        replace_node = remove_node->right;
+        while (replace_node->left)
+        {
+            if constexpr (node_traits<TNode>::has_size)
+            {
+                replace_node->size--;
+            }
+            replace_parent_node = replace_node;
+            replace_node = replace_node->left;
+        }
+        if (replace_parent_node != remove_node)
+        //заменяющий элемент не является правым потомком удаляемого:
+        //его правое поддерево занимает его место у предка
+        {
+            replace_parent_node->left = replace_node->right;
+            replace_node->right = remove_node->right;
+        }
+        replace_node->left = remove_node->left;
+        if constexpr (node_traits<TNode>::has_size)
+        {
+            replace_node->size = remove_node->size - 1;
+        }
+    }
+    if (!parent_node)
+    //удаляемый элемент корневой
+    {
+        root_node = replace_node;
+    }
+    else if (compare_result == LESS)
+    {
+        parent_node->left = replace_node;
+    }
+    else
+    {
+        parent_node->right = replace_node;
     }
-    delete remove_node;
+    allocator.destroy(remove_node);
     return REMOVE_SUCCESS;
 }
 
-template <typename TKey, typename TValue>
-void binary_tree<TKey, TValue>::remove_template_method::post_remove_hook(
-        node<TKey, TValue> *&root_node,
-        comparator<TKey> *key_comparator)
+template <typename TNode, typename TComparator>
+void bst_methods::post_remove_hook(
+        TNode *& /*root_node*/,
+        const TComparator & /*key_comparator*/)
 {
 }
 
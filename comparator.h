@@ -1,36 +1,97 @@
 #ifndef COMPARATOR_H
 #define COMPARATOR_H
 
+#include <string>
+#include <type_traits>
+
 enum compare_t {
     EQUAL = 0, //равно
     GREAT = 1, //больше
     LESS = -1  //меньше
 };
 
-template <typename TKey>
+template <typename TKey, typename TEnable = void>
 class comparator
+//трехзначное сравнение ключей произвольного типа
+//требует от ключа только оператора <, сравнение на равенство не выполняется
 {
 public:
     compare_t operator () (const TKey &key_1, const TKey &key_2) const;
+    //сравнение с ключом другого типа (например, const char* или std::string_view с std::string)
+    template <typename TOtherKey>
+    compare_t operator () (const TOtherKey &key_1, const TKey &key_2) const;
 };
 
 template <typename TKey>
-compare_t comparator<TKey>::operator () (const TKey &key_1, const TKey &key_2) const
+class comparator<TKey, typename std::enable_if<std::is_integral<TKey>::value>::type>
+//сравнение целочисленных ключей без ветвлений
 {
-    compare_t result = EQUAL;
-    if (key_1 == key_2)
-    {
-        result = EQUAL;
-    }
-    else if (key_1 > key_2)
+public:
+    compare_t operator () (const TKey &key_1, const TKey &key_2) const;
+    template <typename TOtherKey>
+    compare_t operator () (const TOtherKey &key_1, const TKey &key_2) const;
+};
+
+template <typename TChar, typename TTraits, typename TAlloc>
+class comparator<std::basic_string<TChar, TTraits, TAlloc>, void>
+//сравнение строк одним вызовом compare (общий префикс просматривается один раз)
+{
+public:
+    typedef std::basic_string<TChar, TTraits, TAlloc> key_type;
+
+    compare_t operator () (const key_type &key_1, const key_type &key_2) const;
+    template <typename TOtherKey>
+    compare_t operator () (const TOtherKey &key_1, const key_type &key_2) const;
+};
+
+template <typename TKey, typename TEnable>
+compare_t comparator<TKey, TEnable>::operator () (const TKey &key_1, const TKey &key_2) const
+{
+    if (key_1 < key_2)
     {
-        result = GREAT;
+        return LESS;
     }
-    else if (key_1 < key_2)
+    return (key_2 < key_1) ? GREAT : EQUAL;
+}
+
+template <typename TKey, typename TEnable>
+template <typename TOtherKey>
+compare_t comparator<TKey, TEnable>::operator () (const TOtherKey &key_1, const TKey &key_2) const
+{
+    if (key_1 < key_2)
     {
-        result = LESS;
+        return LESS;
     }
-    return result;
+    return (key_2 < key_1) ? GREAT : EQUAL;
+}
+
+template <typename TKey>
+compare_t comparator<TKey, typename std::enable_if<std::is_integral<TKey>::value>::type>::operator () (const TKey &key_1, const TKey &key_2) const
+{
+    return static_cast<compare_t>((key_1 > key_2) - (key_1 < key_2));
+}
+
+template <typename TKey>
+template <typename TOtherKey>
+compare_t comparator<TKey, typename std::enable_if<std::is_integral<TKey>::value>::type>::operator () (const TOtherKey &key_1, const TKey &key_2) const
+{
+    return static_cast<compare_t>((key_1 > key_2) - (key_1 < key_2));
+}
+
+template <typename TChar, typename TTraits, typename TAlloc>
+compare_t comparator<std::basic_string<TChar, TTraits, TAlloc>, void>::operator () (const key_type &key_1, const key_type &key_2) const
+{
+    int result = key_1.compare(key_2);
+    return static_cast<compare_t>((result > 0) - (result < 0));
+}
+
+template <typename TChar, typename TTraits, typename TAlloc>
+template <typename TOtherKey>
+compare_t comparator<std::basic_string<TChar, TTraits, TAlloc>, void>::operator () (const TOtherKey &key_1, const key_type &key_2) const
+//ключ другого типа (const char*, std::string_view) сравнивается со строкой тем же compare, знак результата меняется
+{
+    int result = key_2.compare(key_1);
+    return static_cast<compare_t>((result < 0) - (result > 0));
 }
 
 #endif // COMPARATOR_H
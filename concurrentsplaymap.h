@@ -0,0 +1,568 @@
+#ifndef CONCURRENTSPLAYMAP_H
+#define CONCURRENTSPLAYMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "splaytree.h"
+
+template <typename TKey>
+class hash_partition
+//распределение ключей по шардам по хешу ключа
+//соседние ключи попадают в разные шарды, поэтому нагрузка распределяется равномерно,
+//но просмотр диапазона требует слияния результатов всех шардов
+{
+public:
+    //шарды не упорядочены по ключам
+    static const bool ordered = false;
+
+    //по умолчанию - по шарду на аппаратный поток
+    explicit hash_partition(size_t shard_count = 0);
+    size_t shard_count() const;
+    size_t shard_of(const TKey &key) const;
+private:
+    size_t count;
+};
+
+template <typename TKey, typename TComparator = comparator<TKey>>
+class range_partition
+//распределение ключей по диапазонам: шард i хранит ключи из [bounds[i - 1], bounds[i])
+//просмотр диапазона обходит шарды по порядку без слияния
+{
+public:
+    //шарды упорядочены по ключам
+    static const bool ordered = true;
+
+    //bounds - возрастающие границы диапазонов, шардов на один больше, чем границ
+    explicit range_partition(std::vector<TKey> bounds = std::vector<TKey>(),
+                             const TComparator &key_comparator = TComparator());
+    size_t shard_count() const;
+    size_t shard_of(const TKey &key) const;
+private:
+    std::vector<TKey> bounds;
+    TComparator key_comparator;
+};
+
+template <typename TKey, typename TValue, typename TPartition = hash_partition<TKey>,
+          typename TComparator = comparator<TKey>, typename TSplayPolicy = full_splay>
+class concurrent_splay_map
+//потокобезопасное отображение из независимых splay-деревьев (шардов), каждое под своим мьютексом
+//поиск в splay-дереве меняет его форму, поэтому шард блокируется монопольно и при чтении,
+//а параллельность достигается тем, что потоки обращаются к разным шардам
+//значения возвращаются копиями: ссылки на узлы шарда недействительны после снятия блокировки
+{
+public:
+    typedef splay_tree<TKey, TValue, compact_layout, node_allocator, TComparator, TSplayPolicy> tree_type;
+
+    explicit concurrent_splay_map(const TPartition &partition = TPartition(),
+                                  const TComparator &key_comparator = TComparator());
+    concurrent_splay_map(const concurrent_splay_map &map) = delete;
+    concurrent_splay_map &operator = (const concurrent_splay_map &map) = delete;
+
+    //при отсутствии элемента выбрасывается исключение дерева
+    TValue find(const TKey &key);
+    //при отсутствии элемента возвращает false, value не меняется
+    bool try_find(const TKey &key, TValue &value);
+    bool contains(const TKey &key);
+    //при наличии элемента с таким ключом выбрасывается исключение дерева
+    void insert(const TKey &key, const TValue &value);
+    //возвращает false, если элемент с таким ключом уже есть
+    bool try_insert(const TKey &key, const TValue &value);
+    //при отсутствии элемента выбрасывается исключение дерева
+    void remove(const TKey &key);
+    //возвращает false, если элемента не было
+    bool try_remove(const TKey &key);
+    size_t size() const;
+    size_t shard_count() const;
+
+    //просмотр элементов с ключами из [key_1, key_2) в порядке возрастания ключей
+    //элементы каждого шарда копируются под его блокировкой, а посетитель visitor(key, value)
+    //вызывается уже без блокировок; если он возвращает bool, то false прекращает просмотр
+    //результат согласован внутри каждого шарда, но не между шардами
+    template <typename TVisitor>
+    bool for_each_in_range(const TKey &key_1, const TKey &key_2, TVisitor &&visitor);
+private:
+    struct alignas(64) shard
+    //шард занимает отдельные строки кеша, чтобы блокировки соседних шардов не мешали друг другу
+    {
+        mutable std::mutex lock;
+        tree_type tree;
+    };
+    typedef std::vector<std::pair<TKey, TValue>> range_type;
+
+    shard &shard_of(const TKey &key);
+    //копирование элементов диапазона одного шарда
+    void collect_range(shard &range_shard, const TKey &key_1, const TKey &key_2, range_type &range);
+
+    TPartition partition;
+    TComparator key_comparator;
+    size_t count;
+    std::unique_ptr<shard[]> shards;
+};
+
+template <typename TKey, typename TValue, typename TComparator = comparator<TKey>>
+class combining_splay_map
+//потокобезопасное splay-дерево с журналом обращений (flat combining)
+//поиск выполняется под разделяемой блокировкой обычным спуском, не меняющим дерево,
+//а ключ записывается в журнал - одну из ячеек, закрепленных за потоками по хешу их идентификатора
+//когда ячейка набирает batch_size ключей, поток пытается взять монопольную блокировку и,
+//если она свободна, становится комбинатором: выполняет splay по всем ключам всех ячеек пакетом
+//так читатели не блокируют друг друга, а дерево сохраняет большую часть адаптивности splay
+//при переполнении ячейки (комбинатор долго не запускается) новые обращения не записываются
+{
+public:
+    typedef splay_tree<TKey, TValue, compact_layout, node_allocator, TComparator> tree_type;
+
+    //slot_count - количество ячеек журнала (по умолчанию - по ячейке на аппаратный поток),
+    //batch_size - размер ячейки, при котором запускается комбинатор
+    explicit combining_splay_map(size_t slot_count = 0,
+                                 size_t batch_size = 256,
+                                 const TComparator &key_comparator = TComparator());
+    combining_splay_map(const combining_splay_map &map) = delete;
+    combining_splay_map &operator = (const combining_splay_map &map) = delete;
+
+    //при отсутствии элемента выбрасывается исключение дерева
+    TValue find(const TKey &key);
+    bool try_find(const TKey &key, TValue &value);
+    bool contains(const TKey &key);
+    //изменения выполняются под монопольной блокировкой
+    void insert(const TKey &key, const TValue &value);
+    bool try_insert(const TKey &key, const TValue &value);
+    void remove(const TKey &key);
+    bool try_remove(const TKey &key);
+    size_t size() const;
+    //немедленное применение всех записанных обращений
+    void combine();
+private:
+    struct alignas(64) access_slot
+    //ячейка журнала на отдельных строках кеша
+    {
+        std::mutex lock;
+        std::vector<TKey> keys;
+    };
+
+    //запись ключа в ячейку потока и запуск комбинатора при ее заполнении
+    void record(const TKey &key);
+    //splay по всем записанным ключам (вызывается под монопольной блокировкой)
+    void apply_log();
+
+    //size() пересчитывает количество элементов в дереве, поэтому тоже берет монопольную блокировку
+    mutable std::shared_mutex tree_lock;
+    tree_type tree;
+    TComparator key_comparator;
+    size_t slot_count;
+    size_t batch_size;
+    std::unique_ptr<access_slot[]> slots;
+};
+
+template <typename TKey>
+hash_partition<TKey>::hash_partition(size_t shard_count) : count(shard_count)
+{
+    if (!count)
+    {
+        count = std::thread::hardware_concurrency();
+    }
+    if (!count)
+    {
+        count = 1;
+    }
+}
+
+template <typename TKey>
+size_t hash_partition<TKey>::shard_count() const
+{
+    return count;
+}
+
+template <typename TKey>
+size_t hash_partition<TKey>::shard_of(const TKey &key) const
+{
+    //std::hash для целых - тождественная функция, поэтому хеш перемешивается умножением Фибоначчи
+    uint64_t hash = static_cast<uint64_t>(std::hash<TKey>()(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>((hash >> 32) % count);
+}
+
+template <typename TKey, typename TComparator>
+range_partition<TKey, TComparator>::range_partition(std::vector<TKey> bounds, const TComparator &key_comparator) :
+    bounds(std::move(bounds)),
+    key_comparator(key_comparator)
+{
+}
+
+template <typename TKey, typename TComparator>
+size_t range_partition<TKey, TComparator>::shard_count() const
+{
+    return bounds.size() + 1;
+}
+
+template <typename TKey, typename TComparator>
+size_t range_partition<TKey, TComparator>::shard_of(const TKey &key) const
+//количество границ, не превосходящих key (двоичный поиск)
+{
+    size_t low = 0;
+    size_t high = bounds.size();
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (key_comparator(key, bounds[middle]) == LESS)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::concurrent_splay_map(const TPartition &partition,
+                                                                                               const TComparator &key_comparator) :
+    partition(partition),
+    key_comparator(key_comparator),
+    count(partition.shard_count()),
+    shards(new shard[count])
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        shards[i].tree = tree_type(key_comparator);
+    }
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+TValue concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::find(const TKey &key)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    return key_shard.tree.find(key);
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+bool concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::try_find(const TKey &key, TValue &value)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    TValue *find_value = key_shard.tree.try_find(key);
+    if (!find_value)
+    {
+        return false;
+    }
+    value = *find_value;
+    return true;
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+bool concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::contains(const TKey &key)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    return key_shard.tree.contains(key);
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+void concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::insert(const TKey &key, const TValue &value)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    key_shard.tree.insert(key, value);
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+bool concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::try_insert(const TKey &key, const TValue &value)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    return key_shard.tree.try_emplace(key, value).second;
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+void concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::remove(const TKey &key)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    key_shard.tree.remove(key);
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+bool concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::try_remove(const TKey &key)
+{
+    shard &key_shard = shard_of(key);
+    std::lock_guard<std::mutex> guard(key_shard.lock);
+    return key_shard.tree.try_remove(key);
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+size_t concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::size() const
+//сумма размеров шардов; при параллельных изменениях - приблизительная
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        std::lock_guard<std::mutex> guard(shards[i].lock);
+        total += shards[i].tree.size();
+    }
+    return total;
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+size_t concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::shard_count() const
+{
+    return count;
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+template <typename TVisitor>
+bool concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::for_each_in_range(const TKey &key_1,
+                                                                                                 const TKey &key_2,
+                                                                                                 TVisitor &&visitor)
+{
+    if (key_comparator(key_1, key_2) != LESS)
+    //диапазон пустой
+    {
+        return true;
+    }
+    if constexpr (TPartition::ordered)
+    //шарды упорядочены: просматриваются только шарды, пересекающиеся с диапазоном, по порядку
+    {
+        size_t last_shard = partition.shard_of(key_2);
+        range_type range;
+        for (size_t i = partition.shard_of(key_1); i <= last_shard && i < count; i++)
+        {
+            range.clear();
+            collect_range(shards[i], key_1, key_2, range);
+            for (size_t j = 0; j < range.size(); j++)
+            {
+                if (!bst::visit(visitor, range[j].first, range[j].second))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    else
+    //каждый шард может содержать ключи из любой части диапазона: упорядоченные копии шардов
+    //сливаются выбором минимального текущего ключа
+    {
+        std::vector<range_type> ranges(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            collect_range(shards[i], key_1, key_2, ranges[i]);
+        }
+        std::vector<size_t> positions(count, 0);
+        while (true)
+        {
+            size_t min_shard = count;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (positions[i] < ranges[i].size() &&
+                    (min_shard == count ||
+                     key_comparator(ranges[i][positions[i]].first, ranges[min_shard][positions[min_shard]].first) == LESS))
+                {
+                    min_shard = i;
+                }
+            }
+            if (min_shard == count)
+            //все копии исчерпаны
+            {
+                return true;
+            }
+            std::pair<TKey, TValue> &element = ranges[min_shard][positions[min_shard]++];
+            if (!bst::visit(visitor, element.first, element.second))
+            {
+                return false;
+            }
+        }
+    }
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+typename concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::shard &concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::shard_of(const TKey &key)
+{
+    return shards[partition.shard_of(key)];
+}
+
+template <typename TKey, typename TValue, typename TPartition, typename TComparator, typename TSplayPolicy>
+void concurrent_splay_map<TKey, TValue, TPartition, TComparator, TSplayPolicy>::collect_range(shard &range_shard,
+                                                                                             const TKey &key_1,
+                                                                                             const TKey &key_2,
+                                                                                             range_type &range)
+{
+    std::lock_guard<std::mutex> guard(range_shard.lock);
+    range_shard.tree.for_each_in_range(key_1, key_2, [&range](const TKey &key, const TValue &value)
+    {
+        range.emplace_back(key, value);
+    });
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+combining_splay_map<TKey, TValue, TComparator>::combining_splay_map(size_t slot_count,
+                                                                    size_t batch_size,
+                                                                    const TComparator &key_comparator) :
+    tree(key_comparator),
+    key_comparator(key_comparator),
+    slot_count(slot_count ? slot_count : std::thread::hardware_concurrency()),
+    batch_size(batch_size ? batch_size : 1)
+{
+    if (!this->slot_count)
+    {
+        this->slot_count = 1;
+    }
+    slots.reset(new access_slot[this->slot_count]);
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+TValue combining_splay_map<TKey, TValue, TComparator>::find(const TKey &key)
+{
+    std::shared_lock<std::shared_mutex> guard(tree_lock);
+    try
+    {
+        TValue value = static_cast<const tree_type&>(tree).find(key);
+        //запись в журнал может запустить комбинатор, поэтому разделяемая блокировка снимается до нее
+        guard.unlock();
+        record(key);
+        return value;
+    }
+    catch (const tree_exception &)
+    //промах тоже записывается в журнал, как в try_find и contains
+    {
+        guard.unlock();
+        record(key);
+        throw;
+    }
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+bool combining_splay_map<TKey, TValue, TComparator>::try_find(const TKey &key, TValue &value)
+{
+    bool found = false;
+    {
+        std::shared_lock<std::shared_mutex> guard(tree_lock);
+        const TValue *find_value = static_cast<const tree_type&>(tree).try_find(key);
+        if (find_value)
+        {
+            value = *find_value;
+            found = true;
+        }
+    }
+    record(key);
+    return found;
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+bool combining_splay_map<TKey, TValue, TComparator>::contains(const TKey &key)
+{
+    bool found = false;
+    {
+        std::shared_lock<std::shared_mutex> guard(tree_lock);
+        found = static_cast<const tree_type&>(tree).contains(key);
+    }
+    record(key);
+    return found;
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+void combining_splay_map<TKey, TValue, TComparator>::insert(const TKey &key, const TValue &value)
+{
+    std::unique_lock<std::shared_mutex> guard(tree_lock);
+    tree.insert(key, value);
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+bool combining_splay_map<TKey, TValue, TComparator>::try_insert(const TKey &key, const TValue &value)
+{
+    std::unique_lock<std::shared_mutex> guard(tree_lock);
+    return tree.try_emplace(key, value).second;
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+void combining_splay_map<TKey, TValue, TComparator>::remove(const TKey &key)
+{
+    std::unique_lock<std::shared_mutex> guard(tree_lock);
+    tree.remove(key);
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+bool combining_splay_map<TKey, TValue, TComparator>::try_remove(const TKey &key)
+{
+    std::unique_lock<std::shared_mutex> guard(tree_lock);
+    return tree.try_remove(key);
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+size_t combining_splay_map<TKey, TValue, TComparator>::size() const
+{
+    std::unique_lock<std::shared_mutex> guard(tree_lock);
+    return tree.size();
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+void combining_splay_map<TKey, TValue, TComparator>::combine()
+{
+    std::unique_lock<std::shared_mutex> guard(tree_lock);
+    apply_log();
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+void combining_splay_map<TKey, TValue, TComparator>::record(const TKey &key)
+{
+    //хеш идентификатора потока вычисляется один раз
+    static thread_local size_t thread_hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+    access_slot &slot = slots[thread_hash % slot_count];
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> guard(slot.lock);
+        if (slot.keys.size() < 4 * batch_size)
+        {
+            slot.keys.push_back(key);
+        }
+        full = slot.keys.size() >= batch_size;
+    }
+    if (full)
+    //комбинатором становится поток, которому удалось взять монопольную блокировку без ожидания;
+    //остальные продолжают работу, их обращения будут применены следующим комбинатором
+    {
+        std::unique_lock<std::shared_mutex> guard(tree_lock, std::try_to_lock);
+        if (guard.owns_lock())
+        {
+            apply_log();
+        }
+    }
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+void combining_splay_map<TKey, TValue, TComparator>::apply_log()
+{
+    std::vector<TKey> keys;
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        {
+            std::lock_guard<std::mutex> guard(slots[i].lock);
+            keys.swap(slots[i].keys);
+        }
+        for (size_t j = 0; j < keys.size(); j++)
+        {
+            //подряд идущие обращения к одному ключу дают один splay
+            if (j == 0 || key_comparator(keys[j], keys[j - 1]) != EQUAL)
+            {
+                tree.contains(keys[j]);
+            }
+        }
+        keys.clear();
+        //опустевший буфер возвращается в ячейку, чтобы журнал не выделял память заново
+        std::lock_guard<std::mutex> guard(slots[i].lock);
+        if (slots[i].keys.empty())
+        {
+            keys.swap(slots[i].keys);
+        }
+    }
+}
+
+#endif // CONCURRENTSPLAYMAP_H
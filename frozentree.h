@@ -0,0 +1,180 @@
+#ifndef FROZENTREE_H
+#define FROZENTREE_H
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "comparator.h"
+#include "treeexception.h"
+
+template <typename TKey, typename TValue, typename TComparator = comparator<TKey>>
+class frozen_tree
+//неизменяемый снимок дерева для поиска: ключи хранятся в массиве в порядке Эйтцингера
+//(корень - элемент 1, потомки элемента k - элементы 2k и 2k + 1), значения - в параллельном массиве
+//верхние уровни неявного дерева лежат в нескольких соседних строках кеша, поэтому промахов кеша
+//на поиск меньше, чем при спуске по указателям, а спуск не содержит условных переходов
+//поиск не меняет снимок, поэтому его можно вызывать из любого числа потоков без блокировок
+{
+public:
+    //вложенный класс исключения "ошибка поиска"
+    class find_error_exception : public tree_exception
+    {
+    public:
+        template <typename TOtherKey>
+        find_error_exception(const TOtherKey &key);
+    };
+
+    frozen_tree(const TComparator &key_comparator = TComparator());
+    //построение снимка из отсортированной последовательности пар (ключ, значение) без повторяющихся ключей
+    //(итераторы произвольного доступа), O(n) без сравнений
+    template <typename TIterator>
+    frozen_tree(TIterator first, TIterator last, const TComparator &key_comparator = TComparator());
+
+    //поиск по ключу (или ключу другого типа, который умеет сравнивать компаратор)
+    //при отсутствии элемента find выбрасывает исключение, а try_find возвращает nullptr
+    template <typename TOtherKey>
+    const TValue &find(const TOtherKey &key) const;
+    template <typename TOtherKey>
+    const TValue *try_find(const TOtherKey &key) const;
+    template <typename TOtherKey>
+    bool contains(const TOtherKey &key) const;
+    size_t size() const;
+    bool empty() const;
+private:
+    //номер (с 1) первого элемента с ключом не меньше key в порядке Эйтцингера, 0 - такого нет
+    template <typename TOtherKey>
+    size_t lower_bound_index(const TOtherKey &key) const;
+
+    //элемент k неявного дерева хранится по индексу k - 1
+    std::vector<TKey> keys;
+    std::vector<TValue> values;
+    TComparator key_comparator;
+};
+
+template <typename TKey, typename TValue, typename TComparator>
+template <typename TOtherKey>
+frozen_tree<TKey, TValue, TComparator>::find_error_exception::find_error_exception(const TOtherKey &key)
+{
+    std::stringstream key_string;
+    key_string << key;
+    std::string exception_message = "Find error. Element with key \"" + key_string.str() + "\" not found.";
+    set_exception_message(exception_message);
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+frozen_tree<TKey, TValue, TComparator>::frozen_tree(const TComparator &key_comparator) : key_comparator(key_comparator)
+{
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+template <typename TIterator>
+frozen_tree<TKey, TValue, TComparator>::frozen_tree(TIterator first, TIterator last, const TComparator &key_comparator) :
+    key_comparator(key_comparator)
+{
+    size_t count = static_cast<size_t>(last - first);
+    //номер элемента неявного дерева для каждого элемента последовательности:
+    //симметричный обход неявного дерева перечисляет номера в порядке возрастания ключей
+    std::vector<size_t> order(count);
+    size_t index = 1;
+    while (2 * index <= count)
+    {
+        index *= 2;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        order[index - 1] = i;
+        if (2 * index + 1 <= count)
+        //следующий - минимальный в правом поддереве
+        {
+            index = 2 * index + 1;
+            while (2 * index <= count)
+            {
+                index *= 2;
+            }
+        }
+        else
+        //иначе поднимаемся, пока приходим в предка из правого поддерева
+        {
+            while (index & 1)
+            {
+                index >>= 1;
+            }
+            index >>= 1;
+        }
+    }
+    keys.reserve(count);
+    values.reserve(count);
+    for (size_t k = 0; k < count; k++)
+    {
+        keys.push_back(first[order[k]].first);
+        values.push_back(first[order[k]].second);
+    }
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+template <typename TOtherKey>
+const TValue &frozen_tree<TKey, TValue, TComparator>::find(const TOtherKey &key) const
+{
+    const TValue *find_value = try_find(key);
+    if (!find_value)
+    {
+        throw find_error_exception(key);
+    }
+    return *find_value;
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+template <typename TOtherKey>
+const TValue *frozen_tree<TKey, TValue, TComparator>::try_find(const TOtherKey &key) const
+{
+    size_t index = lower_bound_index(key);
+    if (!index || key_comparator(key, keys[index - 1]) != EQUAL)
+    //все ключи меньше key или первый не меньший ключ больше key
+    {
+        return nullptr;
+    }
+    return &values[index - 1];
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+template <typename TOtherKey>
+bool frozen_tree<TKey, TValue, TComparator>::contains(const TOtherKey &key) const
+{
+    return try_find(key) != nullptr;
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+size_t frozen_tree<TKey, TValue, TComparator>::size() const
+{
+    return keys.size();
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+bool frozen_tree<TKey, TValue, TComparator>::empty() const
+{
+    return keys.empty();
+}
+
+template <typename TKey, typename TValue, typename TComparator>
+template <typename TOtherKey>
+size_t frozen_tree<TKey, TValue, TComparator>::lower_bound_index(const TOtherKey &key) const
+{
+    size_t count = keys.size();
+    size_t index = 1;
+    //спуск до листа без ветвлений: направление добавляется к номеру как младший бит
+    //(для целочисленных ключей сравнение тоже не содержит переходов)
+    while (index <= count)
+    {
+        index = 2 * index + (key_comparator(key, keys[index - 1]) == GREAT);
+    }
+    //младшие единичные биты - последние шаги вправо; искомый элемент - тот,
+    //от которого был сделан последний шаг влево
+    while (index & 1)
+    {
+        index >>= 1;
+    }
+    return index >> 1;
+}
+
+#endif // FROZENTREE_H
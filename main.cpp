@@ -14,7 +14,7 @@ void example_1()
 {
     //пример бинарного дерева с ключем типа "int" и данными типа "string"
     cout << "Example 1:" << endl << "TKey - int, TValue - string" << endl;
-    comparator<int> *comparator_int = new comparator<int>;
+    comparator<int> comparator_int;
     //создаем экземпляр бинарного дерева
     splay_tree<int, string> *tree = new splay_tree<int, string>(comparator_int);
     try
@@ -86,7 +86,7 @@ void example_2()
 {
     //пример бинарного дерева с ключем типа "string" и данными типа "string"
     cout << "Example 1:" << endl << "TKey - string, TValue - string" << endl;
-    comparator<string> *comparator_string = new comparator<string>;
+    comparator<string> comparator_string;
     splay_tree<string, string> *tree = new splay_tree<string, string>(comparator_string);
     try
     {
@@ -153,7 +153,7 @@ void example_3()
 {
     //проверка перегруженного оператора присваивания
     cout << "Testing the assignment operator:" << endl;
-    comparator<int> *comparator_int = new comparator<int>;
+    comparator<int> comparator_int;
     splay_tree<int, string> *tree = new splay_tree<int, string>(comparator_int);
     splay_tree<int, string> *tree_copy = new splay_tree<int, string>(comparator_int);
     cout << "An instance of a splay tree named \"tree\"" << endl;
@@ -1,9 +1,19 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include "nodeallocator.h"
+
 template <typename TKey, typename TValue>
 struct node
+//полный узел: помимо ключа, значения и ссылок хранит высоту и цвет
+//(используется сбалансированными деревьями, которым нужны эти поля)
 {
+    typedef TKey key_type;
+    typedef TValue value_type;
     TKey key;
     TValue value;
     int height;
@@ -11,8 +21,12 @@ struct node
     node *left = nullptr;
     node *right = nullptr;
     node();
-    node(TKey key, TValue value);
-    node &operator = (const node &node);
+    //ключ и значение конструируются прямо в узле из переданных аргументов
+    template <typename TKeyArg, typename... TValueArgs,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<TKeyArg>::type, node>::value>::type>
+    node(TKeyArg &&key, TValueArgs&&... value_args);
+    //копия получает все поля узла, включая высоту и цвет (используется при копировании дерева)
+    node(const node &) = default;
 };
 
 template <typename TKey, typename TValue>
@@ -22,10 +36,224 @@ node<TKey, TValue>::node()
 }
 
 template <typename TKey, typename TValue>
-node<TKey, TValue>::node(TKey key, TValue value)
+template <typename TKeyArg, typename... TValueArgs, typename>
+node<TKey, TValue>::node(TKeyArg &&key, TValueArgs&&... value_args) :
+    key(std::forward<TKeyArg>(key)),
+    value(std::forward<TValueArgs>(value_args)...)
+{
+}
+
+template <typename TKey, typename TValue>
+struct compact_node
+//компактный узел: только ключ, значение и две ссылки на потомков
+{
+    typedef TKey key_type;
+    typedef TValue value_type;
+    TKey key;
+    TValue value;
+    compact_node *left = nullptr;
+    compact_node *right = nullptr;
+    compact_node();
+    //ключ и значение конструируются прямо в узле из переданных аргументов
+    template <typename TKeyArg, typename... TValueArgs,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<TKeyArg>::type, compact_node>::value>::type>
+    compact_node(TKeyArg &&key, TValueArgs&&... value_args);
+};
+
+template <typename TKey, typename TValue>
+compact_node<TKey, TValue>::compact_node()
+{
+
+}
+
+template <typename TKey, typename TValue>
+template <typename TKeyArg, typename... TValueArgs, typename>
+compact_node<TKey, TValue>::compact_node(TKeyArg &&key, TValueArgs&&... value_args) :
+    key(std::forward<TKeyArg>(key)),
+    value(std::forward<TValueArgs>(value_args)...)
+{
+}
+
+template <typename TKey, typename TValue>
+struct sized_node
+//компактный узел с размером поддерева (количеством элементов в поддереве с корнем в этом узле)
+//размер поддерева позволяет находить элемент по номеру и номер элемента по ключу за O(log n)
+{
+    typedef TKey key_type;
+    typedef TValue value_type;
+    TKey key;
+    TValue value;
+    size_t size = 1;
+    sized_node *left = nullptr;
+    sized_node *right = nullptr;
+    sized_node();
+    //ключ и значение конструируются прямо в узле из переданных аргументов
+    template <typename TKeyArg, typename... TValueArgs,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<TKeyArg>::type, sized_node>::value>::type>
+    sized_node(TKeyArg &&key, TValueArgs&&... value_args);
+};
+
+template <typename TKey, typename TValue>
+sized_node<TKey, TValue>::sized_node()
+{
+
+}
+
+template <typename TKey, typename TValue>
+template <typename TKeyArg, typename... TValueArgs, typename>
+sized_node<TKey, TValue>::sized_node(TKeyArg &&key, TValueArgs&&... value_args) :
+    key(std::forward<TKeyArg>(key)),
+    value(std::forward<TValueArgs>(value_args)...)
+{
+}
+
+template <typename TNode>
+class index_link
+//32-битная ссылка на узел: индекс узла в массиве node_arena<TNode>
+//ведет себя как указатель на узел (индекс 0 соответствует nullptr)
+{
+public:
+    index_link();
+    index_link(std::nullptr_t);
+    index_link(TNode *p_node);
+    index_link &operator = (TNode *p_node);
+    operator TNode *() const;
+    TNode *operator -> () const;
+private:
+    uint32_t index = 0;
+};
+
+template <typename TNode>
+index_link<TNode>::index_link()
+{
+}
+
+template <typename TNode>
+index_link<TNode>::index_link(std::nullptr_t)
+{
+}
+
+template <typename TNode>
+index_link<TNode>::index_link(TNode *p_node) : index(node_arena<TNode>::index_of(p_node))
+{
+}
+
+template <typename TNode>
+index_link<TNode> &index_link<TNode>::operator = (TNode *p_node)
+{
+    index = node_arena<TNode>::index_of(p_node);
+    return *this;
+}
+
+template <typename TNode>
+index_link<TNode>::operator TNode *() const
 {
-    this->key = key;
-    this->value = value;
+    return node_arena<TNode>::at(index);
 }
 
+template <typename TNode>
+TNode *index_link<TNode>::operator -> () const
+{
+    return node_arena<TNode>::at(index);
+}
+
+template <typename TKey, typename TValue>
+struct index_node
+//компактный узел с 32-битными ссылками на потомков
+//узлы такого типа можно выделять только из node_arena
+{
+    typedef TKey key_type;
+    typedef TValue value_type;
+    TKey key;
+    TValue value;
+    index_link<index_node> left;
+    index_link<index_node> right;
+    index_node();
+    //ключ и значение конструируются прямо в узле из переданных аргументов
+    template <typename TKeyArg, typename... TValueArgs,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<TKeyArg>::type, index_node>::value>::type>
+    index_node(TKeyArg &&key, TValueArgs&&... value_args);
+};
+
+template <typename TKey, typename TValue>
+index_node<TKey, TValue>::index_node()
+{
+
+}
+
+template <typename TKey, typename TValue>
+template <typename TKeyArg, typename... TValueArgs, typename>
+index_node<TKey, TValue>::index_node(TKeyArg &&key, TValueArgs&&... value_args) :
+    key(std::forward<TKeyArg>(key)),
+    value(std::forward<TValueArgs>(value_args)...)
+{
+}
+
+template <typename TNode>
+struct node_traits
+//сведения о дополнительных полях узла, которые нужно поддерживать при изменении формы дерева
+//у узлов без размера поддерева поддерживать нечего, и update() ничего не делает
+{
+    static const bool has_size = false;
+    //пересчет полей узла по его потомкам (вызывается после поворотов и перестановки потомков)
+    static void update(TNode *p_node);
+};
+
+template <typename TNode>
+void node_traits<TNode>::update(TNode * /*p_node*/)
+{
+}
+
+template <typename TKey, typename TValue>
+struct node_traits<sized_node<TKey, TValue>>
+//узел с размером поддерева
+{
+    static const bool has_size = true;
+    //размер поддерева (0 для пустого поддерева)
+    static size_t size(const sized_node<TKey, TValue> *p_node);
+    static void update(sized_node<TKey, TValue> *p_node);
+};
+
+template <typename TKey, typename TValue>
+size_t node_traits<sized_node<TKey, TValue>>::size(const sized_node<TKey, TValue> *p_node)
+{
+    return p_node ? p_node->size : 0;
+}
+
+template <typename TKey, typename TValue>
+void node_traits<sized_node<TKey, TValue>>::update(sized_node<TKey, TValue> *p_node)
+{
+    p_node->size = 1 + size(p_node->left) + size(p_node->right);
+}
+
+//политики выбора структуры узла дерева
+struct full_layout
+//полный узел (с высотой и цветом)
+{
+    template <typename TKey, typename TValue>
+    using node_type = node<TKey, TValue>;
+};
+
+struct compact_layout
+//ключ, значение и два указателя
+{
+    template <typename TKey, typename TValue>
+    using node_type = compact_node<TKey, TValue>;
+};
+
+struct sized_layout
+//ключ, значение, два указателя и размер поддерева (нужен для select() и rank())
+{
+    template <typename TKey, typename TValue>
+    using node_type = sized_node<TKey, TValue>;
+};
+
+struct index_layout
+//ключ, значение и две 32-битные ссылки, узлы хранятся в node_arena
+//(дерево с такой структурой узлов должно использовать распределитель node_arena)
+{
+    template <typename TKey, typename TValue>
+    using node_type = index_node<TKey, TValue>;
+};
+
 #endif // NODE_H
@@ -0,0 +1,378 @@
+#ifndef NODEALLOCATOR_H
+#define NODEALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+template <typename TNode>
+class node_allocator
+//распределитель узлов через стандартные new/delete
+//каждый узел выделяется и освобождается по отдельности
+{
+public:
+    //release() не освобождает память узлов, их нужно уничтожать по одному
+    static const bool bulk_release = false;
+    //узлы можно передавать между деревьями (память узла не привязана к распределителю дерева)
+    static const bool node_transfer = true;
+
+    template <typename... TArgs>
+    TNode *create(TArgs&&... args);
+    void destroy(TNode *p_node);
+    void release();
+    void swap(node_allocator &allocator);
+};
+
+template <typename TNode>
+template <typename... TArgs>
+TNode *node_allocator<TNode>::create(TArgs&&... args)
+{
+    return new TNode(std::forward<TArgs>(args)...);
+}
+
+template <typename TNode>
+void node_allocator<TNode>::destroy(TNode *p_node)
+{
+    delete p_node;
+}
+
+template <typename TNode>
+void node_allocator<TNode>::release()
+{
+}
+
+template <typename TNode>
+void node_allocator<TNode>::swap(node_allocator & /*allocator*/)
+{
+}
+
+template <typename TNode>
+class node_pool
+//пул узлов: память выделяется крупными блоками (слябами) по slab_size узлов,
+//освобожденные узлы попадают в список свободных и используются повторно,
+//а при уничтожении пула слябы освобождаются целиком
+{
+public:
+    //release() освобождает память всех узлов разом
+    static const bool bulk_release = true;
+    //узлы живут в слябах своего пула, поэтому их нельзя передавать другому дереву
+    static const bool node_transfer = false;
+    //количество узлов в одном слябе (около 64 Кб на сляб)
+    static const size_t slab_size = (65536 / sizeof(TNode) > 16) ? 65536 / sizeof(TNode) : 16;
+
+    node_pool();
+    //копия пула всегда пустая: узлы принадлежат только своему дереву
+    node_pool(const node_pool &pool);
+    ~node_pool();
+    node_pool &operator = (const node_pool &pool);
+
+    template <typename... TArgs>
+    TNode *create(TArgs&&... args);
+    void destroy(TNode *p_node);
+    //освобождает все слябы разом, деструкторы узлов при этом не вызываются
+    void release();
+    //обмен слябами и списками свободных ячеек с другим пулом
+    void swap(node_pool &pool);
+private:
+    union slot
+    //ячейка сляба: либо узел, либо ссылка на следующую свободную ячейку
+    {
+        slot *next;
+        alignas(TNode) unsigned char storage[sizeof(TNode)];
+    };
+    slot *allocate_slot();
+
+    std::vector<slot*> slabs;
+    //список свободных ячеек
+    slot *free_list = nullptr;
+    //количество занятых ячеек в последнем слябе
+    size_t slab_used = slab_size;
+};
+
+template <typename TNode>
+node_pool<TNode>::node_pool()
+{
+}
+
+template <typename TNode>
+node_pool<TNode>::node_pool(const node_pool &pool)
+{
+}
+
+template <typename TNode>
+node_pool<TNode>::~node_pool()
+{
+    release();
+}
+
+template <typename TNode>
+node_pool<TNode> &node_pool<TNode>::operator = (const node_pool &pool)
+{
+    return *this;
+}
+
+template <typename TNode>
+typename node_pool<TNode>::slot *node_pool<TNode>::allocate_slot()
+{
+    if (free_list)
+    //повторно используем освобожденную ячейку
+    {
+        slot *p_slot = free_list;
+        free_list = free_list->next;
+        return p_slot;
+    }
+    if (slab_used == slab_size)
+    //текущий сляб заполнен, выделяем новый
+    {
+        slot *slab = static_cast<slot*>(::operator new(slab_size * sizeof(slot)));
+        try
+        {
+            slabs.push_back(slab);
+        }
+        catch (...)
+        {
+            ::operator delete(slab);
+            throw;
+        }
+        slab_used = 0;
+    }
+    return slabs.back() + slab_used++;
+}
+
+template <typename TNode>
+template <typename... TArgs>
+TNode *node_pool<TNode>::create(TArgs&&... args)
+{
+    slot *p_slot = allocate_slot();
+    try
+    {
+        return new (p_slot->storage) TNode(std::forward<TArgs>(args)...);
+    }
+    catch (...)
+    //конструктор узла выбросил исключение, возвращаем ячейку в список свободных
+    {
+        p_slot->next = free_list;
+        free_list = p_slot;
+        throw;
+    }
+}
+
+template <typename TNode>
+void node_pool<TNode>::destroy(TNode *p_node)
+{
+    p_node->~TNode();
+    slot *p_slot = reinterpret_cast<slot*>(p_node);
+    p_slot->next = free_list;
+    free_list = p_slot;
+}
+
+template <typename TNode>
+void node_pool<TNode>::release()
+{
+    for (size_t i = 0; i < slabs.size(); i++)
+    {
+        ::operator delete(slabs[i]);
+    }
+    slabs.clear();
+    free_list = nullptr;
+    slab_used = slab_size;
+}
+
+template <typename TNode>
+void node_pool<TNode>::swap(node_pool &pool)
+{
+    slabs.swap(pool.slabs);
+    std::swap(free_list, pool.free_list);
+    std::swap(slab_used, pool.slab_used);
+}
+
+template <typename TNode>
+class node_arena
+//массив узлов, общий для всех деревьев с данным типом узла
+//узлы адресуются 32-битными индексами (индекс 0 соответствует nullptr) и лежат в блоках по block_bytes байт,
+//выровненных на свой размер: узел по индексу находится через таблицу блоков, а индекс по адресу узла -
+//по номеру блока, записанному в его начале, поэтому блоки не перемещаются, и массив растет по мере
+//надобности до 2^32 - 1 узлов (при исчерпании индексов create() выбрасывает std::bad_alloc)
+//распределитель не потокобезопасен: массив общий, поэтому даже разные деревья с этим типом узла
+//нельзя изменять одновременно из разных потоков; блоки освобождаются, когда уничтожен последний живой узел
+{
+public:
+    static const bool bulk_release = false;
+    //массив общий для всех деревьев, поэтому узлы можно передавать между ними
+    static const bool node_transfer = true;
+    //размер блока и его выравнивание (степень двойки)
+    static const size_t block_bytes = 65536;
+
+    //заранее выделяет блоки под capacity узлов (необязательно, блоки выделяются и при создании узлов)
+    static void reserve(uint32_t capacity);
+    static TNode *at(uint32_t index);
+    static uint32_t index_of(const TNode *p_node);
+
+    template <typename... TArgs>
+    TNode *create(TArgs&&... args);
+    void destroy(TNode *p_node);
+    void release();
+    //массив общий для всех деревьев, обменивать нечего
+    void swap(node_arena &arena);
+private:
+    union slot
+    {
+        uint32_t next;
+        alignas(TNode) unsigned char storage[sizeof(TNode)];
+    };
+
+    //в начале блока хранится его номер, ячейки начинаются с первого выровненного смещения за ним
+    static const size_t slot_offset = (sizeof(uint32_t) + alignof(slot) - 1) / alignof(slot) * alignof(slot);
+    //количество ячеек в блоке
+    static const size_t block_slots = (block_bytes - slot_offset) / sizeof(slot);
+    static_assert(block_slots > 0, "node is too large for node_arena");
+
+    static slot *slot_at(uint32_t index);
+    static void add_block();
+
+    //таблица блоков: блок с номером b содержит ячейки с индексами от b * block_slots
+    static std::vector<unsigned char*> blocks;
+    //количество ячеек, которые уже выдавались (ячейка 0 зарезервирована)
+    static uint32_t used;
+    //количество живых узлов
+    static uint32_t live;
+    //индекс первой свободной ячейки (0 - список пуст)
+    static uint32_t free_list;
+};
+
+template <typename TNode>
+std::vector<unsigned char*> node_arena<TNode>::blocks;
+
+template <typename TNode>
+uint32_t node_arena<TNode>::used = 1;
+
+template <typename TNode>
+uint32_t node_arena<TNode>::live = 0;
+
+template <typename TNode>
+uint32_t node_arena<TNode>::free_list = 0;
+
+template <typename TNode>
+void node_arena<TNode>::reserve(uint32_t capacity)
+{
+    size_t slot_count = static_cast<size_t>(capacity) + 1;
+    while (blocks.size() * block_slots < slot_count)
+    {
+        add_block();
+    }
+}
+
+template <typename TNode>
+void node_arena<TNode>::add_block()
+{
+    unsigned char *block = static_cast<unsigned char*>(::operator new(block_bytes, std::align_val_t(block_bytes)));
+    *reinterpret_cast<uint32_t*>(block) = static_cast<uint32_t>(blocks.size());
+    try
+    {
+        blocks.push_back(block);
+    }
+    catch (...)
+    {
+        ::operator delete(block, std::align_val_t(block_bytes));
+        throw;
+    }
+}
+
+template <typename TNode>
+typename node_arena<TNode>::slot *node_arena<TNode>::slot_at(uint32_t index)
+{
+    return reinterpret_cast<slot*>(blocks[index / block_slots] + slot_offset) + index % block_slots;
+}
+
+template <typename TNode>
+TNode *node_arena<TNode>::at(uint32_t index)
+{
+    return index ? reinterpret_cast<TNode*>(slot_at(index)->storage) : nullptr;
+}
+
+template <typename TNode>
+uint32_t node_arena<TNode>::index_of(const TNode *p_node)
+{
+    if (!p_node)
+    {
+        return 0;
+    }
+    //начало блока - адрес узла, округленный вниз до размера блока
+    uintptr_t address = reinterpret_cast<uintptr_t>(p_node);
+    const unsigned char *block = reinterpret_cast<const unsigned char*>(address & ~static_cast<uintptr_t>(block_bytes - 1));
+    uint32_t block_index = *reinterpret_cast<const uint32_t*>(block);
+    size_t slot_index = reinterpret_cast<const slot*>(p_node) - reinterpret_cast<const slot*>(block + slot_offset);
+    return static_cast<uint32_t>(block_index * block_slots + slot_index);
+}
+
+template <typename TNode>
+template <typename... TArgs>
+TNode *node_arena<TNode>::create(TArgs&&... args)
+{
+    uint32_t index = free_list;
+    if (index)
+    //повторно используем освобожденную ячейку
+    {
+        free_list = slot_at(index)->next;
+    }
+    else if (used < UINT32_MAX)
+    {
+        if (used / block_slots >= blocks.size())
+        //все выделенные блоки заняты
+        {
+            add_block();
+        }
+        index = used++;
+    }
+    else
+    //индексы исчерпаны
+    {
+        throw std::bad_alloc();
+    }
+    try
+    {
+        TNode *p_node = new (slot_at(index)->storage) TNode(std::forward<TArgs>(args)...);
+        live++;
+        return p_node;
+    }
+    catch (...)
+    {
+        slot_at(index)->next = free_list;
+        free_list = index;
+        throw;
+    }
+}
+
+template <typename TNode>
+void node_arena<TNode>::destroy(TNode *p_node)
+{
+    uint32_t index = index_of(p_node);
+    p_node->~TNode();
+    slot_at(index)->next = free_list;
+    free_list = index;
+    if (!--live)
+    //на массив больше никто не ссылается, освобождаем все блоки
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            ::operator delete(blocks[i], std::align_val_t(block_bytes));
+        }
+        blocks.clear();
+        used = 1;
+        free_list = 0;
+    }
+}
+
+template <typename TNode>
+void node_arena<TNode>::release()
+{
+}
+
+template <typename TNode>
+void node_arena<TNode>::swap(node_arena & /*arena*/)
+{
+}
+
+#endif // NODEALLOCATOR_H
@@ -1,34 +1,40 @@
 #ifndef AVLTREE_H
 #define AVLTREE_H
 
+#include <cstdint>
+#include <vector>
 #include "binarytree.h"
 
 namespace splay {
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *find_remove_node(node<TKey, TValue> *root_node, TKey key, comparator<TKey> *key_comparator)
+    template <typename TNode, typename TKey, typename TComparator>
+    TNode *find_remove_node(TNode *root_node, const TKey &key, const TComparator &key_comparator)
     {
         return bst::find_remove_node(root_node, key, key_comparator);
     }
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *rotate_right(node<TKey, TValue> *p_node)
+    template <typename TNode>
+    TNode *rotate_right(TNode *p_node)
     {
-        node<TKey, TValue> *q_node = p_node->left;
+        TNode *q_node = p_node->left;
         p_node->left = q_node->right;
         q_node->right = p_node;
+        node_traits<TNode>::update(p_node);
+        node_traits<TNode>::update(q_node);
         return q_node;
     }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *rotate_left(node<TKey, TValue> *p_node)
+    template <typename TNode>
+    TNode *rotate_left(TNode *p_node)
     {
-        node<TKey, TValue> *q_node = p_node->right;
+        TNode *q_node = p_node->right;
         p_node->right = q_node->left;
         q_node->left = p_node;
+        node_traits<TNode>::update(p_node);
+        node_traits<TNode>::update(q_node);
         return q_node;
     }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *find_max_node(node<TKey, TValue>* root_node)
+    template <typename TNode>
+    TNode *find_max_node(TNode* root_node)
     //найти максимальный элемент в дереве
     {
         if(!root_node)
@@ -36,95 +42,197 @@ namespace splay {
         {
             return nullptr;
         }
-        else if(!root_node->right)
-        //дошли до конца правого поддерева (там где наибольший элемент)
+        //идем по правому поддереву до конца (там где наибольший элемент)
+        while (root_node->right)
         {
-            return root_node;
-        }
-        else
-        //рекурсивно идем по правому поддереву
-        {
-            return find_max_node(root_node->right);
+            root_node = root_node->right;
         }
+        return root_node;
     }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue> *splay(node<TKey, TValue> *root_node,
-                              node<TKey, TValue> *p_node,
-                              comparator<TKey> *key_comparator)
+    template <typename TNode, typename TKey, typename TComparator>
+    compare_t splay_key(TNode *&root_node,
+                        const TKey &key,
+                        const TComparator &key_comparator)
+    //итеративный нисходящий (top-down) splay по ключу
+    //поднимает в корень элемент с ключом key, а если его нет - последний посещенный элемент
+    //на каждом уровне выполняется ровно одно трехзначное сравнение, стек не используется
+    //возвращает результат сравнения key с ключом нового корня
+    //размеры поддеревьев (если они есть в узле) исправляются по схеме Слитора:
+    //при спуске накапливаются размеры левого и правого деревьев, а после сборки
+    //они расставляются вдоль правого пути левого дерева и левого пути правого дерева
     {
-        //базовые случаи: root_node равен nullptr или ключ находится в корне
-        if (!root_node || (*key_comparator)(p_node->key, root_node->key) == EQUAL)
+        if (!root_node)
+        //дерево пустое
         {
-            return root_node;
+            return EQUAL;
         }
-        //ключ лежит в левом поддереве
-        if ((*key_comparator)(p_node->key, root_node->key) == LESS)
+        //левое дерево (все ключи меньше key) и его максимальный элемент
+        TNode *left_root = nullptr;
+        TNode *left_max = nullptr;
+        //правое дерево (все ключи больше key) и его минимальный элемент
+        TNode *right_root = nullptr;
+        TNode *right_min = nullptr;
+        TNode *current_node = root_node;
+        //количество элементов, ушедших в левое и правое деревья
+        size_t left_size = 0;
+        size_t right_size = 0;
+        compare_t compare_result = key_comparator(key, current_node->key);
+        while (compare_result != EQUAL)
         {
-            //ключа нет в дереве, мы закончили
-            if (!root_node->left)
-            {
-                return root_node;
-            }
-            //zig-zig (левый-левый)
-            if ((*key_comparator)(p_node->key, root_node->left->key) == LESS)
+            if (compare_result == LESS)
+            //ключ лежит в левом поддереве
             {
-                //cначала рекурсивно поднимем ключ как корень left-left
-                root_node->left->left = splay(root_node->left->left, p_node, key_comparator);
-                //первый разворот для root_node, второй разворот выполняется после else
-                root_node = rotate_right(root_node);
+                TNode *child_node = current_node->left;
+                if (!child_node)
+                //ключа нет в дереве
+                {
+                    break;
+                }
+                compare_result = key_comparator(key, child_node->key);
+                if (compare_result == LESS)
+                //zig-zig (левый-левый): поворачиваем направо
+                {
+                    current_node->left = child_node->right;
+                    child_node->right = current_node;
+                    node_traits<TNode>::update(current_node);
+                    current_node = child_node;
+                    child_node = current_node->left;
+                    if (!child_node)
+                    {
+                        break;
+                    }
+                    compare_result = key_comparator(key, child_node->key);
+                }
+                //присоединяем current_node к правому дереву
+                if constexpr (node_traits<TNode>::has_size)
+                {
+                    right_size += 1 + node_traits<TNode>::size(current_node->right);
+                }
+                if (right_min)
+                {
+                    right_min->left = current_node;
+                }
+                else
+                {
+                    right_root = current_node;
+                }
+                right_min = current_node;
+                current_node = child_node;
             }
-            //zig-zag (Левый-правый)
-            else if ((*key_comparator)(p_node->key, root_node->left->key) == GREAT)
+            else
+            //ключ лежит в правом поддереве
             {
-                //сначала рекурсивно поднимаем ключ как корень left-right
-                root_node->left->right = splay(root_node->left->right, p_node, key_comparator);
-
-                //выполняем первый разворот для root_node->left
-                if (root_node->left->right)
+                TNode *child_node = current_node->right;
+                if (!child_node)
+                //ключа нет в дереве
+                {
+                    break;
+                }
+                compare_result = key_comparator(key, child_node->key);
+                if (compare_result == GREAT)
+                //zag-zag (правый-правый): поворачиваем налево
+                {
+                    current_node->right = child_node->left;
+                    child_node->left = current_node;
+                    node_traits<TNode>::update(current_node);
+                    current_node = child_node;
+                    child_node = current_node->right;
+                    if (!child_node)
+                    {
+                        break;
+                    }
+                    compare_result = key_comparator(key, child_node->key);
+                }
+                //присоединяем current_node к левому дереву
+                if constexpr (node_traits<TNode>::has_size)
                 {
-                    root_node->left = rotate_left(root_node->left);
+                    left_size += 1 + node_traits<TNode>::size(current_node->left);
                 }
+                if (left_max)
+                {
+                    left_max->right = current_node;
+                }
+                else
+                {
+                    left_root = current_node;
+                }
+                left_max = current_node;
+                current_node = child_node;
             }
-            //выполняем второй разворот для корня
-            return (!root_node->left)? root_node: rotate_right(root_node);
         }
-        //ключ находится в правом поддереве
-        else if ((*key_comparator)(p_node->key, root_node->key) == GREAT)
+        if constexpr (node_traits<TNode>::has_size)
+        //поддеревья нового корня тоже уходят в левое и правое деревья
         {
-            //ключа нет в дереве, мы закончили
-            if (!root_node->right)
-            {
-                return root_node;
-            }
-            //zag-zig (правый-левый)
-            if ((*key_comparator)(p_node->key, root_node->right->key) == LESS)
+            left_size += node_traits<TNode>::size(current_node->left);
+            right_size += node_traits<TNode>::size(current_node->right);
+        }
+        //собираем дерево: поддеревья нового корня уходят в левое и правое деревья
+        if (left_max)
+        {
+            left_max->right = current_node->left;
+            current_node->left = left_root;
+        }
+        if (right_min)
+        {
+            right_min->left = current_node->right;
+            current_node->right = right_root;
+        }
+        if constexpr (node_traits<TNode>::has_size)
+        //размеры узлов на правом пути левого дерева и левом пути правого дерева
+        //уменьшаются сверху вниз на размер отходящего от пути поддерева
+        {
+            current_node->size = left_size + right_size + 1;
+            for (TNode *path_node = left_root; path_node; path_node = path_node->right)
             {
-                //поднять ключ как корень right-left
-                root_node->right->left = splay(root_node->right->left, p_node, key_comparator);
-
-                //выполняем первый поворот для root_node->right
-                if (root_node->right->left)
+                path_node->size = left_size;
+                if (path_node == left_max)
                 {
-                    root_node->right = rotate_right(root_node->right);
+                    break;
                 }
+                left_size -= 1 + node_traits<TNode>::size(path_node->left);
             }
-            //zag-zag (правый-правый)
-            else if ((*key_comparator)(p_node->key, root_node->right->key) == GREAT)
+            for (TNode *path_node = right_root; path_node; path_node = path_node->left)
             {
-                //поднимаем ключ как корень right-right и выполняем первый разворот
-                root_node->right->right = splay(root_node->right->right, p_node, key_comparator);
-                root_node = rotate_left(root_node);
+                path_node->size = right_size;
+                if (path_node == right_min)
+                {
+                    break;
+                }
+                right_size -= 1 + node_traits<TNode>::size(path_node->right);
             }
-            //выполняем второй разворот для root_node
-            return (!root_node->right)? root_node: rotate_left(root_node);
         }
+        root_node = current_node;
+        return compare_result;
     }
 
-    template <typename TKey, typename TValue>
-    void split(node<TKey, TValue> *root_node,
-               node<TKey,TValue> *&right_node,
-               node<TKey, TValue> *&left_node)
+    template <typename TNode, typename TKey, typename TComparator>
+    TNode *splay(TNode *root_node,
+                 const TKey &key,
+                 const TComparator &key_comparator)
+    //поднимает в корень элемент с ключом key (или последний посещенный элемент), возвращает новый корень
+    {
+        splay_key(root_node, key, key_comparator);
+        return root_node;
+    }
+
+    template <typename TNode, typename TComparator>
+    TNode *splay(TNode *root_node,
+                 TNode *p_node,
+                 const TComparator &key_comparator)
+    //поднимает в корень элемент p_node, возвращает новый корень
+    {
+        if (!p_node)
+        {
+            return root_node;
+        }
+        return splay(root_node, p_node->key, key_comparator);
+    }
+
+    template <typename TNode>
+    void split(TNode *root_node,
+               TNode *&right_node,
+               TNode *&left_node)
     {
         //если дерево пустое
         if(!root_node)
@@ -137,19 +245,20 @@ namespace splay {
         left_node = root_node->left;
     }
 
-    template <typename TKey, typename TValue>
-    node<TKey, TValue>* merge(node<TKey,TValue> *right_node,
-                              node<TKey, TValue> *left_node,
-                              comparator<TKey> *key_comparator)
+    template <typename TNode, typename TComparator>
+    TNode* merge(TNode *right_node,
+                 TNode *left_node,
+                 const TComparator &key_comparator)
     {
         //ищем максимальный элемент в левом дереве и поднимаем его в корень
-        node<TKey,TValue> *max_node = splay::find_max_node(left_node);
+        TNode *max_node = splay::find_max_node(left_node);
         left_node = splay(left_node, max_node, key_comparator);
         //соединем правое и левое деревья (при этом корнем получившегося дерева будет left_node)
         if (left_node)
         //если левое дерево не пустое
         {
             left_node->right = right_node;
+            node_traits<TNode>::update(left_node);
         }
         else
         //если левое дерево пустое
@@ -158,106 +267,735 @@ namespace splay {
         }
         return left_node;
     }
-}
 
-template <typename TKey, typename TValue>
-class splay_tree : public binary_tree<TKey, TValue>
-{
-protected:
-    class splay_find_template_method : public binary_tree<TKey, TValue>::find_template_method
+    template <typename TNode, typename TKey, typename TComparator>
+    void split_key(TNode *root_node,
+                   const TKey &key,
+                   const TComparator &key_comparator,
+                   TNode *&left_node,
+                   TNode *&right_node)
+    //делит дерево на элементы с ключами меньше key (left_node) и не меньше key (right_node)
+    //поднимает в корень ближайший к key элемент и отрезает от него одно поддерево
     {
-    protected:
-        void post_find_hook(node<TKey, TValue> *&root_node,
-                            node<TKey, TValue> *&find_node,
-                            comparator<TKey> *key_comparator);
+        if (!root_node)
+        {
+            left_node = nullptr;
+            right_node = nullptr;
+            return;
+        }
+        if (splay_key(root_node, key, key_comparator) == GREAT)
+        //ключ корня меньше key, корень остается в левом дереве
+        {
+            left_node = root_node;
+            right_node = root_node->right;
+            root_node->right = nullptr;
+        }
+        else
+        //ключ корня не меньше key, корень уходит в правое дерево
+        {
+            right_node = root_node;
+            left_node = root_node->left;
+            root_node->left = nullptr;
+        }
+        node_traits<TNode>::update(root_node);
+    }
 
-    };
-    class splay_insert_template_method : public binary_tree<TKey, TValue>::insert_template_method
+    template <typename TNode>
+    std::vector<TNode*> &path_buffer()
+    //буфер пути для политик, перестраивающих путь снизу вверх
+    //один на поток и тип узла, чтобы поиск не выделял память при каждом обращении
     {
-    protected:
-        void post_insert_hook(node<TKey, TValue> *&root_node,
-                              node<TKey, TValue> *&insert_node,
-                              comparator<TKey> *key_comparator);
+        static thread_local std::vector<TNode*> path;
+        return path;
+    }
 
-    };
-    class splay_remove_template_method : public binary_tree<TKey, TValue>::remove_template_method
+    template <typename TNode, typename TKey, typename TComparator>
+    compare_t find_path(TNode *root_node,
+                        const TKey &key,
+                        const TComparator &key_comparator,
+                        std::vector<TNode*> &path)
+    //спуск без изменения дерева с запоминанием пути от корня до элемента с ключом key
+    //(если его нет - до последнего посещенного элемента)
+    //возвращает результат сравнения key с ключом последнего элемента пути
     {
-    protected:
-        status_t inner_remove(node<TKey, TValue> *&root_node,
-                              TKey key,
-                              comparator<TKey> *key_comparator);
+        path.clear();
+        compare_t compare_result = EQUAL;
+        try
+        {
+            while (root_node)
+            {
+                path.push_back(root_node);
+                compare_result = key_comparator(key, root_node->key);
+                if (compare_result == EQUAL)
+                {
+                    break;
+                }
+                root_node = (compare_result == LESS) ? root_node->left : root_node->right;
+            }
+        }
+        catch (...)
+        //недостроенный путь не должен попасть в следующий хук
+        {
+            path.clear();
+            throw;
+        }
+        return compare_result;
+    }
+}
+
+struct full_splay : public bst_methods
+//статическая политика шагов шаблонных методов splay-дерева: полный splay при каждом обращении
+//хуки вставки и удаления наследуются от политики бинарного дерева поиска
+//остальные политики splay (semi_splay, depth_splay, periodic_splay, random_splay) наследуют от нее
+//вставку и удаление и меняют только перестройку дерева при поиске
+{
+    static const bool find_restructures = true;
+    //поиск выполняется нисходящим splay по ключу, поэтому найденный элемент сразу оказывается в корне
+    template <typename TNode, typename TKey, typename TComparator>
+    static status_t inner_find(TNode *&root_node,
+                               const TKey &key,
+                               const TComparator &key_comparator,
+                               TNode *&find_node,
+                               size_t node_count);
+    //поднимает в корень элемент, найденный поиском по ключу другого типа
+    template <typename TNode, typename TComparator>
+    static void post_find_hook(TNode *&root_node,
+                               TNode *&find_node,
+                               const TComparator &key_comparator,
+                               size_t node_count);
+    //вставка выполняется нисходящим splay по ключу и разделением дерева по новому корню
+    template <typename TNode, typename TComparator>
+    static status_t inner_insert(TNode *&root_node,
+                                 const TComparator &key_comparator,
+                                 TNode *&insert_node);
+    template <typename TNode, typename TKey, typename TComparator, typename TNodeAllocator>
+    static status_t inner_remove(TNode *&root_node,
+                                 const TKey &key,
+                                 const TComparator &key_comparator,
+                                 TNodeAllocator &allocator);
+};
+
+template <typename TPolicy>
+struct path_splay : public full_splay
+//общая часть политик, перестраивающих путь к найденному элементу снизу вверх
+//поиск спускается по дереву, не меняя его, и запоминает путь в буфере потока,
+//а хук передает путь политике TPolicy::splay_path(root_node, path, key_comparator, node_count)
+//при промахе перестраивается путь к последнему посещенному элементу
+{
+    template <typename TNode, typename TKey, typename TComparator>
+    static status_t inner_find(TNode *&root_node,
+                               const TKey &key,
+                               const TComparator &key_comparator,
+                               TNode *&find_node,
+                               size_t node_count);
+    //путь, оставленный inner_find, используется повторно; иначе он находится спуском по ключу элемента
+    template <typename TNode, typename TComparator>
+    static void post_find_hook(TNode *&root_node,
+                               TNode *&find_node,
+                               const TComparator &key_comparator,
+                               size_t node_count);
+};
 
-    };
+struct semi_splay : public path_splay<semi_splay>
+//полу-splay: каждый шаг поднимает элемент на два уровня, но в случае zig-zig поворачивается
+//только родитель, и подъем продолжается от него; глубина элементов пути уменьшается примерно вдвое,
+//а количество записей в узлы - примерно вдвое меньше, чем при полном splay
+{
+    template <typename TNode, typename TComparator>
+    static void splay_path(TNode *&root_node,
+                           std::vector<TNode*> &path,
+                           const TComparator &key_comparator,
+                           size_t node_count);
+};
+
+template <unsigned depth_factor = 2>
+struct depth_splay : public path_splay<depth_splay<depth_factor>>
+//splay по порогу глубины: элемент поднимается в корень, только если глубина обращения
+//больше depth_factor * log2(n); обращения к неглубоким элементам дерево не меняют
+{
+    template <typename TNode, typename TComparator>
+    static void splay_path(TNode *&root_node,
+                           std::vector<TNode*> &path,
+                           const TComparator &key_comparator,
+                           size_t node_count);
+};
+
+template <typename TPolicy>
+struct sampled_splay : public full_splay
+//общая часть политик, выполняющих полный splay лишь для части обращений
+//решение принимает TPolicy::should_splay(), остальные обращения дерево не меняют
+{
+    template <typename TNode, typename TKey, typename TComparator>
+    static status_t inner_find(TNode *&root_node,
+                               const TKey &key,
+                               const TComparator &key_comparator,
+                               TNode *&find_node,
+                               size_t node_count);
+    template <typename TNode, typename TComparator>
+    static void post_find_hook(TNode *&root_node,
+                               TNode *&find_node,
+                               const TComparator &key_comparator,
+                               size_t node_count);
+};
+
+template <unsigned period = 16>
+struct periodic_splay : public sampled_splay<periodic_splay<period>>
+//splay при каждом period-м обращении
+//счетчик обращений общий для всех деревьев с этой политикой в пределах потока,
+//поэтому поиск не пишет в память дерева ничего, кроме самих поворотов
+{
+    static bool should_splay();
+};
+
+template <unsigned percent = 10>
+struct random_splay : public sampled_splay<random_splay<percent>>
+//splay с вероятностью percent процентов (генератор xorshift, свой в каждом потоке)
+{
+    static bool should_splay();
+};
+
+template <typename TKey, typename TValue, typename TLayout = compact_layout, template <typename> class TAllocator = node_allocator,
+          typename TComparator = comparator<TKey>, typename TSplayPolicy = full_splay>
+class splay_tree : public binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>
+{
+protected:
+    typedef typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::node_type node_type;
+    typedef typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::allocator_type allocator_type;
 public:
-    splay_tree(comparator<TKey> *key_comparator);
-    splay_tree(binary_tree<TKey, TValue> &tree);
+    splay_tree(const TComparator &key_comparator = TComparator());
+    splay_tree(const splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy> &tree);
+    splay_tree(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator> &tree);
+    splay_tree(splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy> &&tree);
     ~splay_tree();
+    splay_tree& operator = (const splay_tree &tree_object);
+    splay_tree& operator = (splay_tree &&tree_object);
+
+    //запросы по диапазону ключей [key_1, key_2)
+    //элементы диапазона выделяются в отдельное поддерево подъемом границ в корень,
+    //поэтому остальная часть дерева не просматривается
+    //посетитель вызывается как visitor(key, value) в порядке возрастания ключей,
+    //если он возвращает bool, то false прекращает просмотр
+    template <typename TVisitor>
+    bool for_each_in_range(const TKey &key_1, const TKey &key_2, TVisitor &&visitor);
+    size_t count_in_range(const TKey &key_1, const TKey &key_2);
+    //удаление всех элементов диапазона за амортизированное O(log n) и уничтожение удаленных узлов
+    //возвращает количество удаленных элементов
+    size_t erase_range(const TKey &key_1, const TKey &key_2);
+
+    //разделение по ключу за амортизированное O(log n) без копирования узлов:
+    //элементы с ключами не меньше key переносятся в возвращаемое дерево, остальные остаются в этом
+    //без размеров поддеревьев в узлах количество элементов обеих частей пересчитывается при вызове size()
+    splay_tree split(const TKey &key);
+    //присоединение дерева, все ключи которого больше всех ключей этого дерева или меньше их,
+    //за амортизированное O(log n); дерево-аргумент становится пустым
+    //при пересечении диапазонов ключей выбрасывается исключение, и оба дерева не меняются
+    void join(splay_tree &tree);
+protected:
+    //разделение дерева на элементы с ключами меньше key_1, из [key_1, key_2) и не меньше key_2
+    void split_range(const TKey &key_1,
+                     const TKey &key_2,
+                     node_type *&left_node,
+                     node_type *&middle_node,
+                     node_type *&right_node);
+    //обратное соединение частей дерева
+    void join_range(node_type *left_node,
+                    node_type *middle_node,
+                    node_type *right_node);
 };
 
-template <typename TKey, typename TValue>
-splay_tree<TKey, TValue>::splay_tree(comparator<TKey> *key_comparator) : binary_tree<TKey, TValue>::binary_tree()
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::splay_tree(const TComparator &key_comparator) : binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::binary_tree(key_comparator)
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::splay_tree(const splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy> &tree) : binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::binary_tree(tree)
+//конструктор копирования
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::splay_tree(const binary_tree<TKey, TValue, TLayout, TAllocator, TComparator> &tree) : binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::binary_tree(tree)
+//копирование бинарного дерева поиска в splay-дерево (форма дерева сохраняется)
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::splay_tree(splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy> &&tree) : binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::binary_tree(std::move(tree))
+//конструктор перемещения
+//дерево-источник остается пустым, но пригодным к использованию
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::~splay_tree()
+{
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>& splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::operator = (const splay_tree &tree)
+{
+    binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::operator = (tree);
+    return *this;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>& splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::operator = (splay_tree &&tree)
+{
+    binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::operator = (std::move(tree));
+    return *this;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+template <typename TVisitor>
+bool splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::for_each_in_range(const TKey &key_1, const TKey &key_2, TVisitor &&visitor)
 {
-    splay_find_template_method *splay_finder = new splay_find_template_method;
-    splay_insert_template_method *splay_inserter = new splay_insert_template_method;
-    splay_remove_template_method *splay_remover = new splay_remove_template_method;
-    splay_tree<TKey, TValue>::init_template_methods(splay_finder, splay_inserter, splay_remover);
-    this->key_comparator = key_comparator;
+    node_type *left_node = nullptr;
+    node_type *middle_node = nullptr;
+    node_type *right_node = nullptr;
+    split_range(key_1, key_2, left_node, middle_node, right_node);
+    bool completed = true;
+    try
+    {
+        auto range_visitor = [&visitor](const TKey &key, const TValue &value, int)
+        {
+            return bst::visit(visitor, key, value);
+        };
+        completed = this->infix_traversal_base(middle_node, range_visitor);
+    }
+    catch (...)
+    //дерево собирается обратно и при исключении в посетителе
+    {
+        join_range(left_node, middle_node, right_node);
+        throw;
+    }
+    join_range(left_node, middle_node, right_node);
+    return completed;
 }
 
-template <typename TKey, typename TValue>
-splay_tree<TKey, TValue>::splay_tree(binary_tree<TKey, TValue> &tree) : binary_tree<TKey, TValue>::binary_tree(tree)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+size_t splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::count_in_range(const TKey &key_1, const TKey &key_2)
+//при наличии размера поддерева в узлах количество берется из корня выделенного поддерева за O(log n)
 {
+    if constexpr (node_traits<node_type>::has_size)
+    {
+        node_type *left_node = nullptr;
+        node_type *middle_node = nullptr;
+        node_type *right_node = nullptr;
+        split_range(key_1, key_2, left_node, middle_node, right_node);
+        size_t count = node_traits<node_type>::size(middle_node);
+        join_range(left_node, middle_node, right_node);
+        return count;
+    }
+    else
+    {
+        size_t count = 0;
+        for_each_in_range(key_1, key_2, [&count](const TKey &, const TValue &)
+        {
+            count++;
+        });
+        return count;
+    }
+}
 
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+size_t splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::erase_range(const TKey &key_1, const TKey &key_2)
+{
+    node_type *left_node = nullptr;
+    node_type *middle_node = nullptr;
+    node_type *right_node = nullptr;
+    split_range(key_1, key_2, left_node, middle_node, right_node);
+    //поддерево диапазона отсоединено, остальные части соединяются без него
+    join_range(left_node, nullptr, right_node);
+    size_t erase_count = this->destroy_subtree(middle_node);
+    this->node_count -= erase_count;
+    return erase_count;
 }
 
-template <typename TKey, typename TValue>
-splay_tree<TKey, TValue>::~splay_tree()
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy> splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::split(const TKey &key)
 {
+    static_assert(allocator_type::node_transfer, "split() requires an allocator whose nodes can be moved between trees");
+    splay_tree right_tree(this->key_comparator);
+    node_type *left_node = nullptr;
+    node_type *right_node = nullptr;
+    splay::split_key(this->root_node, key, this->key_comparator, left_node, right_node);
+    this->root_node = left_node;
+    right_tree.root_node = right_node;
+    if (!right_node)
+    //все элементы остались в этом дереве
+    {
+        return right_tree;
+    }
+    if (!left_node)
+    //все элементы перешли в новое дерево
+    {
+        right_tree.node_count = this->node_count;
+        right_tree.count_known = this->count_known;
+        this->node_count = 0;
+        this->count_known = true;
+        return right_tree;
+    }
+    if constexpr (node_traits<node_type>::has_size)
+    {
+        right_tree.node_count = node_traits<node_type>::size(right_node);
+        this->node_count = node_traits<node_type>::size(left_node);
+    }
+    else
+    //подсчет элементов частей стоил бы O(n), он откладывается до вызова size()
+    {
+        right_tree.count_known = false;
+        this->count_known = false;
+    }
+    return right_tree;
 }
 
-template <typename TKey, typename TValue>
-void splay_tree<TKey, TValue>::splay_find_template_method::post_find_hook(node<TKey, TValue> *&root_node,
-                                                                        node<TKey, TValue> *&find_node,
-                                                                        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+void splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::join(splay_tree &tree)
 {
-    root_node = splay::splay(root_node, find_node, key_comparator);
+    static_assert(allocator_type::node_transfer, "join() requires an allocator whose nodes can be moved between trees");
+    if (this == &tree || !tree.root_node)
+    {
+        return;
+    }
+    if (!this->root_node)
+    {
+        this->swap(tree);
+        return;
+    }
+    //поднимаем в корни максимальный элемент этого дерева и минимальный элемент присоединяемого
+    node_type *max_node = splay::find_max_node(this->root_node);
+    this->root_node = splay::splay(this->root_node, max_node, this->key_comparator);
+    node_type *min_node = bst::find_min_node<node_type>(tree.root_node);
+    tree.root_node = splay::splay(tree.root_node, min_node, this->key_comparator);
+    if (this->key_comparator(this->root_node->key, tree.root_node->key) == LESS)
+    //присоединяемое дерево целиком правее: оно становится правым поддеревом корня
+    {
+        this->root_node->right = tree.root_node;
+    }
+    else
+    {
+        //присоединяемое дерево должно быть целиком левее
+        min_node = bst::find_min_node<node_type>(this->root_node);
+        this->root_node = splay::splay(this->root_node, min_node, this->key_comparator);
+        max_node = splay::find_max_node(tree.root_node);
+        tree.root_node = splay::splay(tree.root_node, max_node, this->key_comparator);
+        if (this->key_comparator(tree.root_node->key, this->root_node->key) != LESS)
+        //диапазоны ключей пересекаются
+        {
+            throw typename binary_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::order_error_exception(tree.root_node->key);
+        }
+        this->root_node->left = tree.root_node;
+    }
+    node_traits<node_type>::update(this->root_node);
+    this->node_count += tree.node_count;
+    this->count_known = this->count_known && tree.count_known;
+    tree.root_node = nullptr;
+    tree.node_count = 0;
+    tree.count_known = true;
+}
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+void splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::split_range(const TKey &key_1,
+                                                                             const TKey &key_2,
+                                                                             node_type *&left_node,
+                                                                             node_type *&middle_node,
+                                                                             node_type *&right_node)
+{
+    if (this->key_comparator(key_1, key_2) != LESS)
+    //диапазон пустой
+    {
+        left_node = this->root_node;
+        middle_node = nullptr;
+        right_node = nullptr;
+        this->root_node = nullptr;
+        return;
+    }
+    node_type *upper_node = nullptr;
+    splay::split_key(this->root_node, key_1, this->key_comparator, left_node, upper_node);
+    splay::split_key(upper_node, key_2, this->key_comparator, middle_node, right_node);
+    this->root_node = nullptr;
 }
 
-template <typename TKey, typename TValue>
-void splay_tree<TKey, TValue>::splay_insert_template_method::post_insert_hook(node<TKey, TValue> *&root_node,
-                                                                        node<TKey, TValue> *&insert_node,
-                                                                        comparator<TKey> *key_comparator)
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TSplayPolicy>
+void splay_tree<TKey, TValue, TLayout, TAllocator, TComparator, TSplayPolicy>::join_range(node_type *left_node,
+                                                                            node_type *middle_node,
+                                                                            node_type *right_node)
 {
-    root_node = splay::splay(root_node, insert_node, key_comparator);
+    left_node = splay::merge(middle_node, left_node, this->key_comparator);
+    this->root_node = splay::merge(right_node, left_node, this->key_comparator);
 }
 
-template <typename TKey, typename TValue>
-status_t splay_tree<TKey, TValue>::splay_remove_template_method::inner_remove(
-        node<TKey, TValue> *&root_node,
-        TKey key,
-        comparator<TKey> *key_comparator)
-{
-    node<TKey, TValue> *current_node = root_node;
-    node<TKey, TValue> *remove_node = nullptr;
-    node<TKey, TValue> *right_node = nullptr;
-    node<TKey, TValue> *left_node = nullptr;
-    remove_node = splay::find_remove_node(root_node, key, key_comparator);
-    if (!remove_node)
+template <typename TNode, typename TKey, typename TComparator>
+status_t full_splay::inner_find(
+        TNode *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        TNode *&find_node,
+        size_t /*node_count*/)
+{
+    //поднимаем в корень искомый элемент (или последний посещенный, если искомого нет)
+    if (splay::splay_key(root_node, key, key_comparator) != EQUAL || !root_node)
+    //нужный элемент отсутствует
+    {
+        return FIND_ERROR;
+    }
+    find_node = root_node;
+    return FIND_SUCCESS;
+}
+
+template <typename TNode, typename TComparator>
+void full_splay::post_find_hook(
+        TNode *&root_node,
+        TNode *&find_node,
+        const TComparator &key_comparator,
+        size_t /*node_count*/)
+{
+    //после поиска нисходящим splay элемент уже находится в корне
+    if (find_node != root_node)
+    {
+        root_node = splay::splay(root_node, find_node, key_comparator);
+    }
+}
+
+template <typename TNode, typename TComparator>
+status_t full_splay::inner_insert(
+        TNode *&root_node,
+        const TComparator &key_comparator,
+        TNode *&insert_node)
+{
+    if (!root_node)
+    //дерево пустое
+    {
+        root_node = insert_node;
+        return INSERT_SUCCESS;
+    }
+    //поднимаем в корень ближайший к вставляемому ключу элемент
+    compare_t compare_result = splay::splay_key(root_node, insert_node->key, key_comparator);
+    if (compare_result == EQUAL)
+    //элемент с таким ключем уже существует
+    {
+        return INSERT_ERROR;
+    }
+    if (compare_result == LESS)
+    //старый корень и его правое поддерево уходят направо от нового корня
+    {
+        insert_node->left = root_node->left;
+        insert_node->right = root_node;
+        root_node->left = nullptr;
+    }
+    else
+    //старый корень и его левое поддерево уходят налево от нового корня
+    {
+        insert_node->right = root_node->right;
+        insert_node->left = root_node;
+        root_node->right = nullptr;
+    }
+    node_traits<TNode>::update(root_node);
+    node_traits<TNode>::update(insert_node);
+    root_node = insert_node;
+    return INSERT_SUCCESS;
+}
+
+template <typename TNode, typename TKey, typename TComparator, typename TNodeAllocator>
+status_t full_splay::inner_remove(
+        TNode *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        TNodeAllocator &allocator)
+{
+    TNode *remove_node = nullptr;
+    TNode *right_node = nullptr;
+    TNode *left_node = nullptr;
+    //подымаем удаляемый элемент в корень
+    if (splay::splay_key(root_node, key, key_comparator) != EQUAL || !root_node)
     //удаляемый элемент отсутствует
     {
         return REMOVE_ERROR;
     }
-    //подымаем удаляемый элемент в корень
-    root_node = splay::splay(root_node, remove_node, key_comparator);
     //делим на два дерева
     splay::split(root_node, right_node, left_node);
     //удаляем корневой элемент (в корне и находится элемент, который нужно удалить)
     remove_node = right_node;
     right_node = right_node->right;
-    delete remove_node;
+    allocator.destroy(remove_node);
     //соединяем два дерева в одно (в получившемся дереве уже не будет элемента, который нужно удалить)
     root_node = splay::merge(right_node, left_node, key_comparator);
     return REMOVE_SUCCESS;
 }
 
+template <typename TPolicy>
+template <typename TNode, typename TKey, typename TComparator>
+status_t path_splay<TPolicy>::inner_find(
+        TNode *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        TNode *&find_node,
+        size_t node_count)
+{
+    std::vector<TNode*> &path = splay::path_buffer<TNode>();
+    if (splay::find_path(root_node, key, key_comparator, path) != EQUAL || path.empty())
+    //нужный элемент отсутствует, перестраиваем путь к последнему посещенному
+    {
+        if (!path.empty())
+        {
+            TPolicy::splay_path(root_node, path, key_comparator, node_count);
+            path.clear();
+        }
+        return FIND_ERROR;
+    }
+    //путь остается в буфере до вызова хука
+    find_node = path.back();
+    return FIND_SUCCESS;
+}
+
+template <typename TPolicy>
+template <typename TNode, typename TComparator>
+void path_splay<TPolicy>::post_find_hook(
+        TNode *&root_node,
+        TNode *&find_node,
+        const TComparator &key_comparator,
+        size_t node_count)
+{
+    std::vector<TNode*> &path = splay::path_buffer<TNode>();
+    if (path.empty() || path.back() != find_node)
+    //элемент найден не через inner_find
+    {
+        splay::find_path(root_node, find_node->key, key_comparator, path);
+    }
+    TPolicy::splay_path(root_node, path, key_comparator, node_count);
+    path.clear();
+}
+
+template <typename TNode, typename TComparator>
+void semi_splay::splay_path(
+        TNode *&root_node,
+        std::vector<TNode*> &path,
+        const TComparator & /*key_comparator*/,
+        size_t /*node_count*/)
+{
+    //index - позиция в пути поднимаемого элемента
+    size_t index = path.size() - 1;
+    while (index >= 2)
+    {
+        TNode *grand_node = path[index - 2];
+        TNode *parent_node = path[index - 1];
+        TNode *current_node = path[index];
+        bool parent_left = static_cast<TNode*>(grand_node->left) == parent_node;
+        bool current_left = static_cast<TNode*>(parent_node->left) == current_node;
+        //вершина тройки после преобразования
+        TNode *top_node = nullptr;
+        if (parent_left == current_left)
+        //zig-zig: поворачивается только родитель, подъем продолжается от него
+        {
+            top_node = parent_left ? splay::rotate_right(grand_node) : splay::rotate_left(grand_node);
+        }
+        else if (parent_left)
+        //zig-zag: элемент поднимается на место деда
+        {
+            grand_node->left = splay::rotate_left(parent_node);
+            top_node = splay::rotate_right(grand_node);
+        }
+        else
+        {
+            grand_node->right = splay::rotate_right(parent_node);
+            top_node = splay::rotate_left(grand_node);
+        }
+        //подвешиваем вершину тройки на место деда
+        if (index == 2)
+        {
+            root_node = top_node;
+        }
+        else if (static_cast<TNode*>(path[index - 3]->left) == grand_node)
+        {
+            path[index - 3]->left = top_node;
+        }
+        else
+        {
+            path[index - 3]->right = top_node;
+        }
+        path[index - 2] = top_node;
+        index -= 2;
+    }
+}
+
+template <unsigned depth_factor>
+template <typename TNode, typename TComparator>
+void depth_splay<depth_factor>::splay_path(
+        TNode *&root_node,
+        std::vector<TNode*> &path,
+        const TComparator &key_comparator,
+        size_t node_count)
+{
+    //высота идеально сбалансированного дерева из node_count элементов
+    size_t balanced_height = 0;
+    for (size_t count = node_count; count; count >>= 1)
+    {
+        balanced_height++;
+    }
+    if (path.size() - 1 > depth_factor * balanced_height)
+    //обращение слишком глубокое, поднимаем элемент в корень
+    {
+        splay::splay_key(root_node, path.back()->key, key_comparator);
+    }
+}
+
+template <typename TPolicy>
+template <typename TNode, typename TKey, typename TComparator>
+status_t sampled_splay<TPolicy>::inner_find(
+        TNode *&root_node,
+        const TKey &key,
+        const TComparator &key_comparator,
+        TNode *&find_node,
+        size_t node_count)
+{
+    if (bst_methods::inner_find(root_node, key, key_comparator, find_node, node_count) == FIND_SUCCESS)
+    //решение о splay найденного элемента принимает хук
+    {
+        return FIND_SUCCESS;
+    }
+    if (root_node && TPolicy::should_splay())
+    //поднимаем в корень последний посещенный элемент
+    {
+        splay::splay_key(root_node, key, key_comparator);
+    }
+    return FIND_ERROR;
+}
+
+template <typename TPolicy>
+template <typename TNode, typename TComparator>
+void sampled_splay<TPolicy>::post_find_hook(
+        TNode *&root_node,
+        TNode *&find_node,
+        const TComparator &key_comparator,
+        size_t /*node_count*/)
+{
+    if (TPolicy::should_splay() && find_node != root_node)
+    {
+        root_node = splay::splay(root_node, find_node, key_comparator);
+    }
+}
+
+template <unsigned period>
+bool periodic_splay<period>::should_splay()
+{
+    static thread_local unsigned access_count = 0;
+    if (++access_count < period)
+    {
+        return false;
+    }
+    access_count = 0;
+    return true;
+}
+
+template <unsigned percent>
+bool random_splay<percent>::should_splay()
+{
+    static thread_local uint32_t state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % 100 < percent;
+}
+
 #endif // AVLTREE_H
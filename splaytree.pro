@@ -1,5 +1,5 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++17
 CONFIG -= app_bundle
 CONFIG -= qt
 
@@ -9,6 +9,10 @@ SOURCES += \
 HEADERS += \
     binarytree.h \
     comparator.h \
+    concurrentsplaymap.h \
+    frozentree.h \
+    nodeallocator.h \
     node.h \
     splaytree.h \
-    treeexception.h
+    treeexception.h \
+    treeiterator.h
@@ -0,0 +1,505 @@
+#ifndef TREEITERATOR_H
+#define TREEITERATOR_H
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "comparator.h"
+#include "node.h"
+
+template <typename TKey, typename TValue, typename TLayout, template <typename> class TAllocator, typename TComparator, typename TMethods>
+class binary_tree;
+
+template <typename TNode, bool is_const>
+class tree_iterator
+//двунаправленный итератор по элементам дерева в порядке возрастания ключей
+//хранит путь от корня до текущего узла, поэтому узлам не нужны ссылки на предков:
+//переход к соседнему элементу выполняется за амортизированное O(1),
+//а просмотр k элементов, начиная с найденного, - за O(log n + k)
+//итератор становится недействительным после любого изменения формы дерева
+//(в splay-дереве - в том числе после поиска)
+{
+    template <typename, typename, typename, template <typename> class, typename, typename>
+    friend class binary_tree;
+    template <typename, bool>
+    friend class tree_iterator;
+public:
+    typedef typename TNode::key_type key_type;
+    typedef typename std::conditional<is_const, const typename TNode::value_type, typename TNode::value_type>::type mapped_type;
+    typedef std::bidirectional_iterator_tag iterator_category;
+    //разыменование дает пару ссылок на ключ и значение в узле
+    typedef std::pair<const key_type&, mapped_type&> value_type;
+    typedef value_type reference;
+    typedef void pointer;
+    typedef std::ptrdiff_t difference_type;
+
+    tree_iterator();
+    //неконстантный итератор преобразуется в константный
+    template <bool other_const, typename = typename std::enable_if<is_const && !other_const>::type>
+    tree_iterator(const tree_iterator<TNode, other_const> &position);
+    template <bool other_const, typename = typename std::enable_if<is_const && !other_const>::type>
+    tree_iterator(tree_iterator<TNode, other_const> &&position);
+
+    const key_type &key() const;
+    mapped_type &value() const;
+    reference operator * () const;
+    tree_iterator &operator ++ ();
+    tree_iterator operator ++ (int);
+    tree_iterator &operator -- ();
+    tree_iterator operator -- (int);
+    template <bool other_const>
+    bool operator == (const tree_iterator<TNode, other_const> &position) const;
+    template <bool other_const>
+    bool operator != (const tree_iterator<TNode, other_const> &position) const;
+private:
+    //итератор end() дерева с корнем root_node
+    explicit tree_iterator(TNode *root_node);
+    //спуск от узла p_node до минимального (максимального) элемента его поддерева
+    void push_min(TNode *p_node);
+    void push_max(TNode *p_node);
+    //установка на первый элемент с ключом не меньше (при upper - строго больше) key
+    //возвращает последний посещенный при спуске узел
+    template <typename TOtherKey, typename TComparator>
+    TNode *seek(const TOtherKey &key, const TComparator &key_comparator, bool upper);
+    //установка на элемент с номером index в порядке возрастания ключей (нужен размер поддерева в узлах)
+    //возвращает найденный узел или nullptr, если элементов не больше index
+    TNode *seek_index(size_t index);
+    //спуск к key от позиции (пальца), заданной путем finger_path (пустой путь - спуск от корня):
+    //сначала проверяется окрестность пальца - если key лежит между ним и соседним элементом,
+    //спуск идет прямо от него, иначе подъем по предкам-границам со стороны key до первой,
+    //за которую key не выходит, и спуск от предыдущей; совпадение с границей - попадание без спуска
+    //finger_path только читается (может быть и путем самого итератора): в путь итератора копируется
+    //лишь общая с результатом часть, после чего он заканчивается последним посещенным узлом
+    //возвращает результат сравнения key с ключом последнего посещенного узла (EQUAL для пустого дерева)
+    template <typename TOtherKey, typename TComparator>
+    compare_t seek_finger(const std::vector<TNode*> &finger_path, const TOtherKey &key, const TComparator &key_comparator);
+    //глубины ближайших предков последнего узла finger_path, ключи которых ограничивают его поддерево
+    //сверху (upper_depth) и снизу (lower_depth): граница - узел finger_path[depth - 1], 0 - границы нет
+    //результат запоминается, поэтому при вставке подряд идущих ключей путь не просматривается заново
+    void finger_bounds(const std::vector<TNode*> &finger_path, size_t &upper_depth, size_t &lower_depth);
+    //путь итератора - первые length узлов finger_path
+    void assign_path(const std::vector<TNode*> &finger_path, size_t length);
+    //запоминание границ последнего узла пути по известным границам узла path[depth]
+    //(повороты пути ниже depth); вызывается после спуска, поэтому не требует отдельного подъема
+    void track_bounds(size_t depth, size_t upper_depth, size_t lower_depth);
+
+    TNode *root_node = nullptr;
+    //путь от корня до текущего узла (пустой путь соответствует end())
+    std::vector<TNode*> path;
+    //последние известные границы (finger_bounds, track_bounds): границы узла finger_node на глубине finger_depth
+    //(действительны, пока этот узел лежит на пути на той же глубине)
+    TNode *finger_node = nullptr;
+    size_t finger_depth = 0;
+    size_t finger_upper = 0;
+    size_t finger_lower = 0;
+};
+
+template <typename TNode, bool is_const>
+tree_iterator<TNode, is_const>::tree_iterator()
+{
+}
+
+template <typename TNode, bool is_const>
+tree_iterator<TNode, is_const>::tree_iterator(TNode *root_node) : root_node(root_node)
+{
+}
+
+template <typename TNode, bool is_const>
+template <bool other_const, typename>
+tree_iterator<TNode, is_const>::tree_iterator(const tree_iterator<TNode, other_const> &position) :
+    root_node(position.root_node),
+    path(position.path),
+    finger_node(position.finger_node),
+    finger_depth(position.finger_depth),
+    finger_upper(position.finger_upper),
+    finger_lower(position.finger_lower)
+{
+}
+
+template <typename TNode, bool is_const>
+template <bool other_const, typename>
+tree_iterator<TNode, is_const>::tree_iterator(tree_iterator<TNode, other_const> &&position) :
+    root_node(position.root_node),
+    path(std::move(position.path)),
+    finger_node(position.finger_node),
+    finger_depth(position.finger_depth),
+    finger_upper(position.finger_upper),
+    finger_lower(position.finger_lower)
+{
+}
+
+template <typename TNode, bool is_const>
+const typename tree_iterator<TNode, is_const>::key_type &tree_iterator<TNode, is_const>::key() const
+{
+    return path.back()->key;
+}
+
+template <typename TNode, bool is_const>
+typename tree_iterator<TNode, is_const>::mapped_type &tree_iterator<TNode, is_const>::value() const
+{
+    return path.back()->value;
+}
+
+template <typename TNode, bool is_const>
+typename tree_iterator<TNode, is_const>::reference tree_iterator<TNode, is_const>::operator * () const
+{
+    return reference(path.back()->key, path.back()->value);
+}
+
+template <typename TNode, bool is_const>
+tree_iterator<TNode, is_const> &tree_iterator<TNode, is_const>::operator ++ ()
+//переход к следующему по возрастанию ключа элементу
+{
+    TNode *current_node = path.back();
+    TNode *right_node = current_node->right;
+    if (right_node)
+    //следующий элемент - минимальный в правом поддереве
+    {
+        push_min(right_node);
+        return *this;
+    }
+    //иначе поднимаемся, пока приходим в предка из правого поддерева
+    path.pop_back();
+    while (!path.empty() && current_node == static_cast<TNode*>(path.back()->right))
+    {
+        current_node = path.back();
+        path.pop_back();
+    }
+    return *this;
+}
+
+template <typename TNode, bool is_const>
+tree_iterator<TNode, is_const> tree_iterator<TNode, is_const>::operator ++ (int)
+{
+    tree_iterator position = *this;
+    ++(*this);
+    return position;
+}
+
+template <typename TNode, bool is_const>
+tree_iterator<TNode, is_const> &tree_iterator<TNode, is_const>::operator -- ()
+//переход к предыдущему по возрастанию ключа элементу (из end() - к максимальному)
+{
+    if (path.empty())
+    {
+        push_max(root_node);
+        return *this;
+    }
+    TNode *current_node = path.back();
+    TNode *left_node = current_node->left;
+    if (left_node)
+    //предыдущий элемент - максимальный в левом поддереве
+    {
+        push_max(left_node);
+        return *this;
+    }
+    //иначе поднимаемся, пока приходим в предка из левого поддерева
+    path.pop_back();
+    while (!path.empty() && current_node == static_cast<TNode*>(path.back()->left))
+    {
+        current_node = path.back();
+        path.pop_back();
+    }
+    return *this;
+}
+
+template <typename TNode, bool is_const>
+tree_iterator<TNode, is_const> tree_iterator<TNode, is_const>::operator -- (int)
+{
+    tree_iterator position = *this;
+    --(*this);
+    return position;
+}
+
+template <typename TNode, bool is_const>
+template <bool other_const>
+bool tree_iterator<TNode, is_const>::operator == (const tree_iterator<TNode, other_const> &position) const
+{
+    if (path.empty() || position.path.empty())
+    {
+        return path.empty() && position.path.empty();
+    }
+    return path.back() == position.path.back();
+}
+
+template <typename TNode, bool is_const>
+template <bool other_const>
+bool tree_iterator<TNode, is_const>::operator != (const tree_iterator<TNode, other_const> &position) const
+{
+    return !(*this == position);
+}
+
+template <typename TNode, bool is_const>
+void tree_iterator<TNode, is_const>::push_min(TNode *p_node)
+{
+    bool from_root = path.empty();
+    while (p_node)
+    {
+        path.push_back(p_node);
+        p_node = p_node->left;
+    }
+    if (from_root)
+    {
+        track_bounds(0, 0, 0);
+    }
+}
+
+template <typename TNode, bool is_const>
+void tree_iterator<TNode, is_const>::push_max(TNode *p_node)
+{
+    bool from_root = path.empty();
+    while (p_node)
+    {
+        path.push_back(p_node);
+        p_node = p_node->right;
+    }
+    if (from_root)
+    {
+        track_bounds(0, 0, 0);
+    }
+}
+
+template <typename TNode, bool is_const>
+template <typename TOtherKey, typename TComparator>
+TNode *tree_iterator<TNode, is_const>::seek(const TOtherKey &key, const TComparator &key_comparator, bool upper)
+{
+    path.clear();
+    TNode *current_node = root_node;
+    TNode *last_node = nullptr;
+    //длина пути до последнего подходящего элемента
+    size_t bound_depth = 0;
+    while (current_node)
+    {
+        last_node = current_node;
+        path.push_back(current_node);
+        compare_t compare_result = key_comparator(key, current_node->key);
+        if (compare_result == LESS || (compare_result == EQUAL && !upper))
+        //текущий элемент подходит, ищем меньший подходящий слева
+        {
+            bound_depth = path.size();
+            current_node = current_node->left;
+        }
+        else
+        {
+            current_node = current_node->right;
+        }
+    }
+    path.resize(bound_depth);
+    track_bounds(0, 0, 0);
+    return last_node;
+}
+
+template <typename TNode, bool is_const>
+TNode *tree_iterator<TNode, is_const>::seek_index(size_t index)
+{
+    path.clear();
+    finger_node = nullptr;
+    TNode *current_node = root_node;
+    while (current_node)
+    {
+        path.push_back(current_node);
+        size_t left_size = node_traits<TNode>::size(current_node->left);
+        if (index < left_size)
+        {
+            current_node = current_node->left;
+        }
+        else if (index == left_size)
+        {
+            track_bounds(0, 0, 0);
+            return current_node;
+        }
+        else
+        {
+            index -= left_size + 1;
+            current_node = current_node->right;
+        }
+    }
+    path.clear();
+    return nullptr;
+}
+
+template <typename TNode, bool is_const>
+template <typename TOtherKey, typename TComparator>
+compare_t tree_iterator<TNode, is_const>::seek_finger(const std::vector<TNode*> &finger_path, const TOtherKey &key, const TComparator &key_comparator)
+{
+    TNode *current_node = root_node;
+    compare_t compare_result = EQUAL;
+    //depth - глубина узла, от которого идет спуск, upper_depth и lower_depth - его границы (если известны)
+    size_t depth = 0;
+    size_t upper_depth = 0;
+    size_t lower_depth = 0;
+    bool bounds_known = true;
+    if (finger_path.empty())
+    {
+        path.clear();
+    }
+    else
+    //окрестность текущего элемента: если key больше него и меньше верхней границы его поддерева
+    //(или меньше него и больше нижней), key лежит в соответствующем поддереве текущего узла
+    {
+        TNode *finger = finger_path.back();
+        compare_result = key_comparator(key, finger->key);
+        if (compare_result == EQUAL)
+        {
+            assign_path(finger_path, finger_path.size());
+            return EQUAL;
+        }
+        finger_bounds(finger_path, upper_depth, lower_depth);
+        size_t bound_depth = (compare_result == LESS) ? lower_depth : upper_depth;
+        depth = finger_path.size() - 1;
+        if (bound_depth)
+        {
+            compare_t bound_result = key_comparator(key, finger_path[bound_depth - 1]->key);
+            if (bound_result == EQUAL)
+            {
+                assign_path(finger_path, bound_depth);
+                return EQUAL;
+            }
+            if (bound_result == compare_result)
+            //key за границей: границы с другой стороны заведомо меньше (больше) key,
+            //поэтому подъем идет только по предкам-границам той же стороны до первой, за которую key не выходит
+            {
+                depth = bound_depth - 1;
+                //side_depth и other_depth - ближайшие к узлу depth границы со стороны key и с другой стороны
+                size_t side_depth = 0;
+                size_t other_depth = 0;
+                size_t current_depth = depth;
+                for (; current_depth > 0; current_depth--)
+                {
+                    TNode *parent_node = finger_path[current_depth - 1];
+                    TNode *side_child = (compare_result == LESS) ? parent_node->right : parent_node->left;
+                    if (side_child != finger_path[current_depth])
+                    {
+                        if (!other_depth)
+                        {
+                            other_depth = current_depth;
+                        }
+                        continue;
+                    }
+                    bound_result = key_comparator(key, parent_node->key);
+                    if (bound_result == EQUAL)
+                    {
+                        assign_path(finger_path, current_depth);
+                        return EQUAL;
+                    }
+                    if (bound_result != compare_result)
+                    {
+                        side_depth = current_depth;
+                        break;
+                    }
+                    depth = current_depth - 1;
+                    other_depth = 0;
+                }
+                //граница с другой стороны известна, если она встретилась ниже точки остановки
+                //или подъем дошел до корня
+                bounds_known = other_depth || !current_depth;
+                upper_depth = (compare_result == LESS) ? other_depth : side_depth;
+                lower_depth = (compare_result == LESS) ? side_depth : other_depth;
+            }
+        }
+        assign_path(finger_path, depth + 1);
+        current_node = (compare_result == LESS) ? path[depth]->left : path[depth]->right;
+    }
+    while (current_node)
+    {
+        path.push_back(current_node);
+        compare_result = key_comparator(key, current_node->key);
+        if (compare_result == EQUAL)
+        {
+            break;
+        }
+        current_node = (compare_result == LESS) ? current_node->left : current_node->right;
+    }
+    if (bounds_known)
+    {
+        track_bounds(depth, upper_depth, lower_depth);
+    }
+    return compare_result;
+}
+
+template <typename TNode, bool is_const>
+void tree_iterator<TNode, is_const>::finger_bounds(const std::vector<TNode*> &finger_path, size_t &upper_depth, size_t &lower_depth)
+{
+    size_t depth = finger_path.size() - 1;
+    bool need_upper = true;
+    bool need_lower = true;
+    upper_depth = 0;
+    lower_depth = 0;
+    //просмотр снизу вверх до первых поворотов налево и направо или до запомненного узла,
+    //выше которого границы уже известны
+    for (size_t current_depth = depth; current_depth > 0 && (need_upper || need_lower); current_depth--)
+    {
+        if (finger_node && current_depth == finger_depth && finger_path[current_depth] == finger_node)
+        {
+            if (need_upper)
+            {
+                upper_depth = finger_upper;
+            }
+            if (need_lower)
+            {
+                lower_depth = finger_lower;
+            }
+            break;
+        }
+        if (static_cast<TNode*>(finger_path[current_depth - 1]->left) == finger_path[current_depth])
+        {
+            if (need_upper)
+            {
+                upper_depth = current_depth;
+                need_upper = false;
+            }
+        }
+        else if (need_lower)
+        {
+            lower_depth = current_depth;
+            need_lower = false;
+        }
+    }
+    finger_node = finger_path.back();
+    finger_depth = depth;
+    finger_upper = upper_depth;
+    finger_lower = lower_depth;
+}
+
+template <typename TNode, bool is_const>
+void tree_iterator<TNode, is_const>::assign_path(const std::vector<TNode*> &finger_path, size_t length)
+{
+    if (&finger_path == &path)
+    {
+        path.resize(length);
+    }
+    else
+    {
+        path.assign(finger_path.begin(), finger_path.begin() + length);
+    }
+}
+
+template <typename TNode, bool is_const>
+void tree_iterator<TNode, is_const>::track_bounds(size_t depth, size_t upper_depth, size_t lower_depth)
+{
+    if (path.empty())
+    {
+        finger_node = nullptr;
+        return;
+    }
+    for (size_t current_depth = depth + 1; current_depth < path.size(); current_depth++)
+    {
+        if (static_cast<TNode*>(path[current_depth - 1]->left) == path[current_depth])
+        {
+            upper_depth = current_depth;
+        }
+        else
+        {
+            lower_depth = current_depth;
+        }
+    }
+    finger_node = path.back();
+    finger_depth = path.size() - 1;
+    finger_upper = upper_depth;
+    finger_lower = lower_depth;
+}
+
+#endif // TREEITERATOR_H